@@ -1,5 +1,7 @@
 #include "Utility/Utility.h"
 
+#include <chrono>
+
 double Utility::sinPos(double x)
 {
 	return (sin(x) + 1.0f) / 2.0f;
@@ -34,4 +36,9 @@ void Utility::hexTo_RGB(const int hex, float& r, float& g, float& b)
 	r = ((hex >> 0b1111) & 0xFF) / 255.0f;
 	g = ((hex >> 0b1000) & 0xFF) / 255.0f;
 	b = (hex & 0xFF) / 255.0f;
+}
+double Utility::getTime()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
\ No newline at end of file
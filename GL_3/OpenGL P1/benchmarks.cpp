@@ -0,0 +1,804 @@
+#include "benchmarks.h"
+#include "scene.h"
+
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <array>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <helpers/meshbuffer.h>
+#include <helpers/meshview.h>
+#include <helpers/meshlod.h>
+#include <helpers/meshoptimizer.h>
+#include <helpers/vertexformat.h>
+#include <helpers/culling.h>
+#include <helpers/maskedocclusion.h>
+#include <helpers/jobsystem.h>
+#include <helpers/transformbatch.h>
+#include <helpers/rayscene.h>
+
+#include <Utility/Utility.h>
+
+// functions
+void addBumps(std::vector<glm::vec3>& vertices, std::mt19937& random);
+int runCullBenchmark(unsigned int count);
+size_t cullBoxesJobs(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible);
+int runTransformBenchmark(unsigned int count);
+int runRayBenchmark(unsigned int count);
+bool bruteForceRay(const RayScene& scene, const Ray& ray, RayHit& hit);
+int runOcclusionBenchmark(unsigned int count);
+int runLodBenchmark(unsigned int count);
+float distanceToMesh(const glm::vec3& point, const MeshView& mesh);
+int runMeshBenchmark(unsigned int count);
+int runFormatBenchmark(unsigned int count);
+
+const BenchmarkEntry BENCHMARKS[] = {
+	{ "--cull-benchmark", "times frustum culling of N objects on the CPU", runCullBenchmark },
+	{ "--transform-benchmark", "times building N model matrices on the CPU", runTransformBenchmark },
+	{ "--ray-benchmark", "times building a BVH over N objects and casting rays through it", runRayBenchmark },
+	{ "--occlusion-benchmark", "times rasterizing the occluders among N objects on the CPU and testing the rest", runOcclusionBenchmark },
+	{ "--lod-benchmark", "times building the LOD chains of N detailed meshes serially and with jobs", runLodBenchmark },
+	{ "--mesh-benchmark", "times optimizing N detailed meshes with shuffled triangles and compares their stats", runMeshBenchmark },
+	{ "--format-benchmark", "encodes the vertices of N detailed meshes in every vertex format and measures size and error", runFormatBenchmark }
+};
+const size_t BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BenchmarkEntry);
+
+const BenchmarkEntry* findBenchmark(const char* flag)
+{
+	for (size_t i = 0; i < BENCHMARK_COUNT; i++)
+	{
+		if (strcmp(BENCHMARKS[i].flag, flag) == 0)
+			return &BENCHMARKS[i];
+	}
+	return NULL;
+}
+
+void addBumps(std::vector<glm::vec3>& vertices, std::mt19937& random)
+{
+	//Waves of their own along every axis, up to 15% of the radius in and out
+	std::uniform_real_distribution<float> frequency(4.0f, 16.0f), phase(0.0f, 6.2831853f);
+	const glm::vec3 f(frequency(random), frequency(random), frequency(random)), p(phase(random), phase(random), phase(random));
+	for (glm::vec3& vertex : vertices)
+		vertex *= 1.0f + 0.15f * std::sin(vertex.x * f.x + p.x) * std::sin(vertex.y * f.y + p.y) * std::sin(vertex.z * f.z + p.z);
+}
+
+int runCullBenchmark(unsigned int count)
+{
+	//Random boxes around a camera looking down -z, no GL context needed
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.2f, 2.0f);
+	CullingBounds bounds;
+	bounds.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+		bounds.set(i, model, glm::vec3(0.0f), glm::vec3(size(random), size(random), size(random)));
+	}
+	const float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
+	const Frustum frustum = Frustum::fromMatrix(glm::perspective(glm::radians(60.0f), aspect, 0.1f, 150.0f));
+
+	//Enough repetitions for ~200M tests per path
+	const size_t repetitions = std::max<size_t>(1, 200000000 / count);
+	std::vector<unsigned int> visible;
+	struct Path { const char* name; size_t (*cull)(const Frustum&, const CullingBounds&, std::vector<unsigned int>&); };
+	const Path paths[] = {
+		{ "boxes, scalar", FrustumCulling::cullBoxesScalar },
+		{ "boxes, SIMD", FrustumCulling::cullBoxes },
+		{ "boxes, SIMD + jobs", cullBoxesJobs },
+		{ "spheres, scalar", FrustumCulling::cullSpheresScalar },
+		{ "spheres, SIMD", FrustumCulling::cullSpheres }
+	};
+	std::cout << "Frustum culling " << count << " objects, SIMD path: " << FrustumCulling::path() << ", " << jobs.threadCount() << " job threads" << std::endl;
+	std::vector<unsigned int> reference;
+	for (const Path& path : paths)
+	{
+		path.cull(frustum, bounds, visible); // warm up
+		const double start = Utility::getTime();
+		for (size_t r = 0; r < repetitions; r++)
+			path.cull(frustum, bounds, visible);
+		const double ms = (Utility::getTime() - start) * 1000.0;
+		std::cout << "  " << path.name << ": " << static_cast<double>(count) * repetitions / ms / 1e6 << " M objects/ms, "
+			<< visible.size() << " visible" << std::endl;
+
+		//SIMD has to agree with the scalar reference before it
+		if (path.cull == FrustumCulling::cullBoxesScalar || path.cull == FrustumCulling::cullSpheresScalar)
+			reference = visible;
+		else if (visible != reference)
+		{
+			std::cout << "ERROR::CULLING::MISMATCH " << path.name << std::endl;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+size_t cullBoxesJobs(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible)
+{
+	//Same split as the object scene, one list per range joined in order
+	static std::vector<std::vector<unsigned int>> ranges;
+	ranges.resize((bounds.size() + CULL_RANGE - 1) / CULL_RANGE);
+	jobs.parallelFor(ranges.size(), 1, [&](size_t first, size_t end)
+	{
+		for (size_t range = first; range < end; range++)
+			FrustumCulling::cullBoxes(frustum, bounds, range * CULL_RANGE, std::min((range + 1) * CULL_RANGE, bounds.size()), ranges[range]);
+	});
+	visible.clear();
+	for (const std::vector<unsigned int>& range : ranges)
+		visible.insert(visible.end(), range.begin(), range.end());
+	return visible.size();
+}
+
+int runTransformBenchmark(unsigned int count)
+{
+	//Random objects, built the way setTransform() does it and with TransformBatch
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<glm::vec3> positions(count), axes(count), scales(count);
+	std::vector<float> angles(count);
+	TransformBatch batch;
+	for (size_t i = 0; i < count; i++)
+	{
+		positions[i] = glm::vec3(unit(random), unit(random), unit(random)) * 100.0f;
+		axes[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1.1f));
+		angles[i] = unit(random) * 180.0f;
+		scales[i] = glm::vec3(1.5f) + glm::vec3(unit(random), unit(random), unit(random));
+		batch.add(positions[i], glm::angleAxis(glm::radians(angles[i]), axes[i]), scales[i]);
+	}
+	const float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
+	const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 300.0f)
+		* glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -150.0f));
+	std::vector<glm::mat4> reference(count), models(count), mvps(count);
+
+	//Enough repetitions for ~20M objects per path
+	const size_t repetitions = std::max<size_t>(1, 20000000 / count);
+	auto time = [&](const char* name, const std::function<void()>& run)
+	{
+		run(); // warm up
+		const double start = Utility::getTime();
+		for (size_t r = 0; r < repetitions; r++)
+			run();
+		const double ms = (Utility::getTime() - start) * 1000.0;
+		std::cout << "  " << name << ": " << static_cast<double>(count) * repetitions / ms / 1000.0 << " M objects/s, "
+			<< ms * 1e6 / (static_cast<double>(count) * repetitions) << " ns per object" << std::endl;
+	};
+	std::cout << "Transforms of " << count << " objects, " << jobs.threadCount() << " job threads" << std::endl;
+	time("scalar t * r * s, model + mvp", [&]()
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::mat4 t = glm::translate(glm::mat4(1.0f), positions[i]);
+			const glm::mat4 r = glm::rotate(glm::mat4(1.0f), glm::radians(angles[i]), axes[i]);
+			const glm::mat4 s = glm::scale(glm::mat4(1.0f), scales[i]);
+			reference[i] = t * r * s;
+			mvps[i] = viewProjection * reference[i];
+		}
+	});
+	time("batch, model", [&]() { batch.compute(0, count, models.data()); });
+	time("batch, model + mvp", [&]() { batch.compute(0, count, viewProjection, models.data(), mvps.data()); });
+	time("batch + jobs, model + mvp", [&]()
+	{
+		jobs.parallelFor(count, 1024, [&](size_t first, size_t end)
+		{
+			batch.compute(first, end, viewProjection, models.data() + first, mvps.data() + first);
+		});
+	});
+
+	//Both have to describe the same objects
+	float error = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::mat4 mvp = viewProjection * reference[i];
+		for (int column = 0; column < 4; column++)
+		{
+			error = std::max(error, glm::length(models[i][column] - reference[i][column]));
+			error = std::max(error, glm::length(mvps[i][column] - mvp[column]));
+		}
+	}
+	std::cout << "  largest difference to scalar: " << error << std::endl;
+	if (error > 1e-3f)
+	{
+		std::cout << "ERROR::TRANSFORMS::MISMATCH" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runRayBenchmark(unsigned int count)
+{
+	//The object scene's block of shapes, no GL context needed
+	const std::vector<glm::mat4> transforms = gridTransforms(count);
+	auto buildScene = [&](RayScene& scene, JobSystem* jobSystem)
+	{
+		for (unsigned int i = 0; i < shapeCount; i++)
+			scene.addMesh(shapes[i].view, jobSystem);
+		for (unsigned int i = 0; i < count; i++)
+			scene.addInstance(i % objectShapeCount, transforms[i]);
+		scene.build(jobSystem);
+	};
+	RayScene serialScene, scene;
+	double start = Utility::getTime();
+	buildScene(serialScene, nullptr);
+	const double serialMs = (Utility::getTime() - start) * 1000.0;
+	start = Utility::getTime();
+	buildScene(scene, &jobs);
+	const double jobsMs = (Utility::getTime() - start) * 1000.0;
+
+	//Every triangle in world space under one BVH, the single level alternative
+	std::vector<glm::vec3> triangles;
+	std::vector<unsigned int> triangleObjects;
+	std::vector<BvhBox> triangleBoxes;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const MeshView& view = shapes[i % objectShapeCount].view;
+		for (size_t t = 0; t < view.triangleCount(); t++)
+		{
+			BvhBox box;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				triangles.push_back(glm::vec3(transforms[i] * glm::vec4(view.vertices[view.indices[t * 3 + corner]], 1.0f)));
+				box.grow(triangles.back());
+			}
+			triangleObjects.push_back(i);
+			triangleBoxes.push_back(box);
+		}
+	}
+	Bvh flat;
+	start = Utility::getTime();
+	flat.build(triangleBoxes);
+	const double flatSerialMs = (Utility::getTime() - start) * 1000.0;
+	start = Utility::getTime();
+	flat.build(triangleBoxes, &jobs);
+	const double flatJobsMs = (Utility::getTime() - start) * 1000.0;
+
+	std::cout << "Ray casting " << count << " objects, " << scene.triangleCount() << " triangles, SIMD path: " << Bvh::path() << ", " << jobs.threadCount() << " job threads" << std::endl;
+	std::cout << "  build, two levels: " << serialMs << " ms, " << jobsMs << " ms with jobs" << std::endl;
+	std::cout << "  build, one level over the triangles: " << flatSerialMs << " ms, " << flatJobsMs << " ms with jobs, " << flat.nodeCount() << " nodes in " << flat.levelCount() << " levels" << std::endl;
+
+	//Primary rays of a 640x360 view from the object scene's camera
+	const unsigned int width = 640, height = 360;
+	const float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
+	const glm::vec3 eye(0.0f, 0.0f, cameraDistance * 0.3f);
+	const glm::mat4 inverse = glm::inverse(glm::perspective(glm::radians(60.0f), aspect, 0.1f, farPlane) * glm::translate(glm::mat4(1.0f), -eye));
+	std::vector<Ray> rays(width * height);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			const glm::vec4 farPoint = inverse * glm::vec4((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f, 1.0f, 1.0f);
+			rays[y * width + x].origin = eye;
+			rays[y * width + x].direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - eye);
+		}
+	}
+
+	//Same hit, or a miss in both, up to the rounding of the instance's local space
+	auto sameHit = [](const RayHit& a, const RayHit& b)
+	{
+		if (a.instance == 0xFFFFFFFFu || b.instance == 0xFFFFFFFFu)
+			return a.instance == b.instance;
+		return std::fabs(a.t - b.t) <= 1e-3f * std::max(1.0f, a.t);
+	};
+	std::vector<RayHit> reference(rays.size()), hits(rays.size());
+	auto cast = [&](const char* name, bool parallel, const std::function<void(const Ray&, RayHit&)>& trace)
+	{
+		std::vector<RayHit>& results = name == nullptr ? reference : hits;
+		auto castRange = [&](size_t first, size_t end)
+		{
+			for (size_t r = first; r < end; r++)
+				trace(rays[r], results[r]);
+		};
+		const double start = Utility::getTime();
+		if (parallel)
+			jobs.parallelFor(rays.size(), 1024, castRange);
+		else
+			castRange(0, rays.size());
+		const double seconds = Utility::getTime() - start;
+		size_t hitCount = 0, mismatches = 0;
+		for (size_t r = 0; r < rays.size(); r++)
+		{
+			hitCount += results[r].instance != 0xFFFFFFFFu ? 1 : 0;
+			mismatches += sameHit(results[r], reference[r]) ? 0 : 1;
+		}
+		std::cout << "  " << (name == nullptr ? "two levels, SIMD" : name) << ": " << rays.size() / seconds / 1e6 << " M rays/s, "
+			<< hitCount << " of " << rays.size() << " hit" << std::endl;
+		return mismatches;
+	};
+	auto traceFlat = [&](const Ray& worldRay, RayHit& hit)
+	{
+		Ray ray = worldRay;
+		hit = RayHit();
+		flat.intersect(ray, [&](unsigned int t, Ray& inner)
+		{
+			if (!RayScene::intersectTriangle(inner, triangles[t * 3], triangles[t * 3 + 1], triangles[t * 3 + 2]))
+				return;
+			hit.t = inner.tMax;
+			hit.instance = triangleObjects[t];
+			hit.triangle = t;
+		});
+	};
+	cast(nullptr, false, [&](const Ray& ray, RayHit& hit) { scene.intersect(ray, hit); });
+	size_t mismatches = 0;
+	mismatches += cast("two levels, scalar", false, [&](const Ray& ray, RayHit& hit) { scene.intersectScalar(ray, hit); });
+	mismatches += cast("two levels, SIMD + jobs", true, [&](const Ray& ray, RayHit& hit) { scene.intersect(ray, hit); });
+	mismatches += cast("two levels, serial build", false, [&](const Ray& ray, RayHit& hit) { serialScene.intersect(ray, hit); });
+	mismatches += cast("one level, SIMD", false, traceFlat);
+
+	//Every 997th ray against every triangle
+	auto checkBruteForce = [&]()
+	{
+		size_t wrong = 0;
+		for (size_t r = 0; r < rays.size(); r += 997)
+		{
+			RayHit hit;
+			bruteForceRay(scene, rays[r], hit);
+			wrong += sameHit(hit, reference[r]) ? 0 : 1;
+		}
+		return wrong;
+	};
+	mismatches += checkBruteForce();
+
+	//A quarter of the objects turn, refit keeps the tree, a rebuild starts over
+	for (unsigned int i = 0; i < count; i += 4)
+		scene.setModel(i, transforms[i] * glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	start = Utility::getTime();
+	scene.refit();
+	const double refitMs = (Utility::getTime() - start) * 1000.0;
+	cast(nullptr, false, [&](const Ray& ray, RayHit& hit) { scene.intersect(ray, hit); });
+	mismatches += checkBruteForce();
+	start = Utility::getTime();
+	scene.build(&jobs);
+	const double rebuildMs = (Utility::getTime() - start) * 1000.0;
+	mismatches += cast("two levels, SIMD after a rebuild", false, [&](const Ray& ray, RayHit& hit) { scene.intersect(ray, hit); });
+	std::cout << "  moving a quarter of the objects: refit " << refitMs << " ms, rebuild " << rebuildMs << " ms" << std::endl;
+
+	//Grazing rays may round differently, anything more is a bug
+	std::cout << "  rays that disagree between paths: " << mismatches << std::endl;
+	if (mismatches > rays.size() / 1000)
+	{
+		std::cout << "ERROR::RAY_SCENE::MISMATCH" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runOcclusionBenchmark(unsigned int count)
+{
+	//The object scene's block from close up, as in the ray benchmark, no GL context needed
+	const std::vector<glm::mat4> transforms = gridTransforms(count);
+	CullingBounds bounds;
+	bounds.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 low, high;
+		localBounds(shapes[i % objectShapeCount], low, high);
+		bounds.set(i, transforms[i], (low + high) * 0.5f, (high - low) * 0.5f);
+	}
+	const float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
+	const glm::vec3 eye(0.0f, 0.0f, cameraDistance * 0.3f);
+	const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, farPlane) * glm::translate(glm::mat4(1.0f), -eye);
+	std::vector<unsigned int> visible, occluders;
+	FrustumCulling::cullBoxes(Frustum::fromMatrix(viewProjection), bounds, visible);
+	chooseOccluders(visible, bounds, viewProjection, occluders);
+	size_t occluderTriangles = 0;
+	for (unsigned int o : occluders)
+		occluderTriangles += shapes[o % objectShapeCount].view.triangleCount();
+
+	MaskedOcclusion buffer, scalar;
+	buffer.resize(OCCLUSION_WIDTH, OCCLUSION_WIDTH * SCREEN_HEIGHT / SCREEN_WIDTH);
+	scalar.resize(buffer.width(), buffer.height());
+	auto fill = [&](MaskedOcclusion& target)
+	{
+		target.begin(viewProjection);
+		for (unsigned int o : occluders)
+			target.add(shapes[o % objectShapeCount].view, transforms[o]);
+	};
+	std::cout << "Occlusion culling " << count << " objects, " << visible.size() << " in the frustum, " << occluders.size() << " occluders with "
+		<< occluderTriangles << " triangles, " << buffer.width() << "x" << buffer.height() << " buffer, SIMD path: " << MaskedOcclusion::path()
+		<< ", " << jobs.threadCount() << " job threads" << std::endl;
+	auto time = [&](const char* name, MaskedOcclusion& target, const std::function<void()>& render)
+	{
+		const int repeats = 20;
+		double seconds = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			fill(target);
+			const double start = Utility::getTime();
+			render();
+			seconds += Utility::getTime() - start;
+		}
+		const double ms = seconds * 1000.0 / repeats;
+		std::cout << "  rasterize, " << name << ": " << ms << " ms, " << occluderTriangles / ms << " occluder triangles/ms, "
+			<< target.rasterizedTriangles() << " reached a pixel" << std::endl;
+	};
+	time("scalar", scalar, [&]() { scalar.renderScalar(nullptr); });
+	time("SIMD", buffer, [&]() { buffer.render(nullptr); });
+	time("SIMD + jobs", buffer, [&]() { buffer.render(&jobs); });
+
+	//Coverage may only differ where a pixel center sits on an edge
+	size_t differentTiles = 0;
+	for (int y = 0; y < buffer.height() / MaskedOcclusion::TILE_HEIGHT; y++)
+	{
+		for (int x = 0; x < buffer.width() / MaskedOcclusion::TILE_WIDTH; x++)
+			differentTiles += buffer.tileDepth(x, y) != scalar.tileDepth(x, y) ? 1 : 0;
+	}
+
+	std::vector<unsigned int> hidden;
+	double start = Utility::getTime();
+	for (unsigned int i : visible)
+	{
+		if (!buffer.visible(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), glm::vec3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i])))
+			hidden.push_back(i);
+	}
+	const double testMs = (Utility::getTime() - start) * 1000.0;
+	std::cout << "  test: " << testMs << " ms, " << visible.size() / testMs << " boxes/ms, " << hidden.size() << " of " << visible.size() << " hidden" << std::endl;
+
+	//A ray from the eye to a point just inside a hidden object has to hit some other object first, on screen
+	RayScene scene;
+	for (unsigned int i = 0; i < shapeCount; i++)
+		scene.addMesh(shapes[i].view, &jobs);
+	for (unsigned int i = 0; i < count; i++)
+		scene.addInstance(i % objectShapeCount, transforms[i]);
+	scene.build(&jobs);
+	std::atomic<size_t> reached(0);
+	jobs.parallelFor(hidden.size(), 64, [&](size_t first, size_t end)
+	{
+		for (size_t h = first; h < end; h++)
+		{
+			const unsigned int object = hidden[h];
+			const MeshView& view = shapes[object % objectShapeCount].view;
+			const glm::vec3 center(bounds.centerX[object], bounds.centerY[object], bounds.centerZ[object]);
+			for (const glm::vec3& vertex : view.vertices)
+			{
+				const glm::vec3 point = glm::mix(glm::vec3(transforms[object] * glm::vec4(vertex, 1.0f)), center, 0.01f);
+				const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+				if (std::fabs(clip.x) > clip.w || std::fabs(clip.y) > clip.w)
+					continue; // off screen, where the buffer has nothing to say
+				Ray ray;
+				ray.origin = eye;
+				ray.direction = glm::normalize(point - eye);
+				RayHit hit;
+				scene.intersect(ray, hit);
+				if (hit.instance == object)
+				{
+					reached++;
+					break;
+				}
+			}
+		}
+	});
+	std::cout << "  tiles that differ between scalar and SIMD: " << differentTiles << ", hidden objects a ray still reaches: " << reached << std::endl;
+	if (reached > 0)
+	{
+		std::cout << "ERROR::MASKED_OCCLUSION::NOT_CONSERVATIVE" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runLodBenchmark(unsigned int count)
+{
+	//Detailed spheres with bumps of their own, no GL context needed
+	std::mt19937 random(1234);
+	std::vector<std::vector<glm::vec3>> vertices(count);
+	std::vector<std::vector<unsigned int>> indices(count);
+	std::vector<MeshView> meshes(count);
+	size_t triangles = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		meshes[i] = generateSphere(4, vertices[i], indices[i]);
+		addBumps(vertices[i], random);
+		triangles += meshes[i].triangleCount();
+	}
+
+	//One mesh per job, the way buildShapeLods() does it
+	std::vector<MeshLod> serial(count), parallel(count);
+	double start = Utility::getTime();
+	for (unsigned int i = 0; i < count; i++)
+		serial[i].build(meshes[i], LOD_MAX_ERROR);
+	const double serialMs = (Utility::getTime() - start) * 1000.0;
+	start = Utility::getTime();
+	jobs.parallelFor(count, 1, [&](size_t first, size_t end)
+	{
+		for (size_t i = first; i < end; i++)
+			parallel[i].build(meshes[i], LOD_MAX_ERROR);
+	});
+	const double jobsMs = (Utility::getTime() - start) * 1000.0;
+	std::cout << "Levels of detail for " << count << " meshes, " << triangles << " triangles, " << jobs.threadCount() << " job threads" << std::endl;
+	std::cout << "  serial: " << serialMs << " ms, jobs: " << jobsMs << " ms, " << triangles / jobsMs << " source triangles/ms" << std::endl;
+
+	//The first chain against its source: largest distance between the surfaces, measured both ways at the vertices.
+	//The distance from which a level is drawn assumes the object scene's widest field of view
+	const float pixelsPerUnit = 0.5f * static_cast<float>(SCREEN_HEIGHT); // 90 degrees at view depth 1
+	const MeshLod& chain = parallel[0];
+	for (size_t level = 1; level < chain.levels.size(); level++)
+	{
+		const MeshView view = chain.levels[level].view();
+		std::vector<float> distances(meshes[0].vertices.count + view.vertices.count);
+		jobs.parallelFor(distances.size(), 64, [&](size_t first, size_t end)
+		{
+			for (size_t v = first; v < end; v++)
+				distances[v] = v < meshes[0].vertices.count ? distanceToMesh(meshes[0].vertices[v], view)
+					: distanceToMesh(view.vertices[v - meshes[0].vertices.count], meshes[0]);
+		});
+		std::cout << "  level " << level << ": " << view.triangleCount() << " triangles, " << view.vertices.count << " vertices, error "
+			<< chain.levels[level].error << ", measured " << *std::max_element(distances.begin(), distances.end()) << ", drawn from "
+			<< chain.levels[level].error * pixelsPerUnit / LOD_PIXEL_ERROR << " units away" << std::endl;
+	}
+
+	//Jobs must not change the result
+	size_t mismatches = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool same = serial[i].levels.size() == parallel[i].levels.size();
+		for (size_t level = 0; same && level < serial[i].levels.size(); level++)
+			same = serial[i].levels[level].indices == parallel[i].levels[level].indices && serial[i].levels[level].vertices == parallel[i].levels[level].vertices;
+		mismatches += same ? 0 : 1;
+	}
+	if (mismatches > 0)
+	{
+		std::cout << "ERROR::MESH_LOD::MISMATCH " << mismatches << " chains differ between serial and jobs" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runMeshBenchmark(unsigned int count)
+{
+	//Detailed bumpy spheres as in runLodBenchmark(), then triangles and vertices shuffled the way an exported mesh may come
+	std::mt19937 random(1234);
+	std::vector<std::vector<glm::vec3>> vertices(count), shuffledVertices(count);
+	std::vector<std::vector<unsigned int>> indices(count), shuffledIndices(count);
+	std::vector<MeshView> authored(count), shuffled(count);
+	size_t triangles = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		authored[i] = generateSphere(4, vertices[i], indices[i]);
+		addBumps(vertices[i], random);
+		triangles += authored[i].triangleCount();
+
+		std::vector<unsigned int> remap(vertices[i].size()), order(authored[i].triangleCount());
+		for (size_t v = 0; v < remap.size(); v++)
+			remap[v] = static_cast<unsigned int>(v);
+		for (size_t t = 0; t < order.size(); t++)
+			order[t] = static_cast<unsigned int>(t);
+		std::shuffle(remap.begin(), remap.end(), random);
+		std::shuffle(order.begin(), order.end(), random);
+		shuffledVertices[i].resize(vertices[i].size());
+		for (size_t v = 0; v < remap.size(); v++)
+			shuffledVertices[i][remap[v]] = vertices[i][v];
+		for (unsigned int t : order)
+		{
+			for (int corner = 0; corner < 3; corner++)
+				shuffledIndices[i].push_back(remap[indices[i][t * 3 + corner]]);
+		}
+		shuffled[i] = MeshView(Span<const glm::vec3>(shuffledVertices[i].data(), shuffledVertices[i].size()),
+			Span<const unsigned int>(shuffledIndices[i].data(), shuffledIndices[i].size()));
+	}
+
+	//One mesh per job, every pass on its own and all of them
+	std::vector<std::vector<glm::vec3>> serialVertices(count), optimizedVertices(count);
+	std::vector<std::vector<unsigned int>> serialIndices(count), optimizedIndices(count), cacheIndices(count), overdrawIndices(count);
+	double start = Utility::getTime();
+	for (unsigned int i = 0; i < count; i++)
+		MeshOptimizer::optimize(shuffled[i], serialVertices[i], serialIndices[i]);
+	const double serialMs = (Utility::getTime() - start) * 1000.0;
+	start = Utility::getTime();
+	jobs.parallelFor(count, 1, [&](size_t first, size_t end)
+	{
+		for (size_t i = first; i < end; i++)
+			MeshOptimizer::optimize(shuffled[i], optimizedVertices[i], optimizedIndices[i]);
+	});
+	const double jobsMs = (Utility::getTime() - start) * 1000.0;
+	double cacheMs = 0.0, overdrawMs = 0.0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		cacheIndices[i].assign(shuffled[i].indices.begin(), shuffled[i].indices.end());
+		start = Utility::getTime();
+		MeshOptimizer::optimizeVertexCache(cacheIndices[i], shuffled[i].vertices.count);
+		cacheMs += (Utility::getTime() - start) * 1000.0;
+		overdrawIndices[i] = cacheIndices[i];
+		start = Utility::getTime();
+		MeshOptimizer::optimizeOverdraw(overdrawIndices[i], shuffled[i].vertices);
+		overdrawMs += (Utility::getTime() - start) * 1000.0;
+	}
+	std::cout << "Mesh optimization for " << count << " meshes, " << triangles << " triangles, " << jobs.threadCount() << " job threads" << std::endl;
+	std::cout << "  serial: " << serialMs << " ms (vertex cache " << cacheMs << " ms, overdraw " << overdrawMs << " ms), jobs: " << jobsMs << " ms, "
+		<< triangles / jobsMs << " triangles/ms" << std::endl;
+
+	//Every order measured the same way, averaged over the meshes
+	const char* names[] = { "authored", "shuffled", "vertex cache", "+ overdraw", "+ vertex fetch" };
+	for (int stage = 0; stage < 5; stage++)
+	{
+		MeshOptimizer::Stats sum;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const std::vector<unsigned int>& stageIndices = stage == 2 ? cacheIndices[i] : stage == 3 ? overdrawIndices[i] : optimizedIndices[i];
+			const MeshView view = stage == 0 ? authored[i] : stage == 1 ? shuffled[i] : stage == 4
+				? MeshView(Span<const glm::vec3>(optimizedVertices[i].data(), optimizedVertices[i].size()), Span<const unsigned int>(optimizedIndices[i].data(), optimizedIndices[i].size()))
+				: MeshView(shuffled[i].vertices, Span<const unsigned int>(stageIndices.data(), stageIndices.size()));
+			const MeshOptimizer::Stats stats = MeshOptimizer::analyze(view);
+			sum.acmr += stats.acmr / count;
+			sum.atvr += stats.atvr / count;
+			sum.overdraw += stats.overdraw / count;
+			sum.overfetch += stats.overfetch / count;
+		}
+		std::cout << "  " << names[stage] << ": ACMR " << sum.acmr << ", ATVR " << sum.atvr << ", overdraw " << sum.overdraw << ", overfetch " << sum.overfetch << std::endl;
+	}
+
+	//Jobs must not change the result, and no pass may add, drop or turn a triangle
+	size_t mismatches = 0, changed = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		mismatches += serialIndices[i] == optimizedIndices[i] && serialVertices[i] == optimizedVertices[i] ? 0 : 1;
+		auto corners = [](const std::vector<glm::vec3>& meshVertices, const unsigned int* meshIndices, size_t meshIndexCount)
+		{
+			//Each triangle starting at its smallest corner keeps the winding but not where it started
+			std::vector<std::array<float, 9>> result(meshIndexCount / 3);
+			for (size_t t = 0; t < result.size(); t++)
+			{
+				const glm::vec3 p[3] = { meshVertices[meshIndices[t * 3]], meshVertices[meshIndices[t * 3 + 1]], meshVertices[meshIndices[t * 3 + 2]] };
+				auto less = [](const glm::vec3& a, const glm::vec3& b) { return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z; };
+				int first = less(p[1], p[0]) ? 1 : 0;
+				first = less(p[2], p[first]) ? 2 : first;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const glm::vec3& q = p[(first + corner) % 3];
+					result[t][corner * 3] = q.x;
+					result[t][corner * 3 + 1] = q.y;
+					result[t][corner * 3 + 2] = q.z;
+				}
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		};
+		changed += corners(shuffledVertices[i], shuffledIndices[i].data(), shuffledIndices[i].size())
+			== corners(optimizedVertices[i], optimizedIndices[i].data(), optimizedIndices[i].size()) ? 0 : 1;
+	}
+	if (mismatches > 0)
+	{
+		std::cout << "ERROR::MESH_OPTIMIZER::MISMATCH " << mismatches << " meshes differ between serial and jobs" << std::endl;
+		return -1;
+	}
+	if (changed > 0)
+	{
+		std::cout << "ERROR::MESH_OPTIMIZER::TRIANGLES_CHANGED " << changed << " meshes" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runFormatBenchmark(unsigned int count)
+{
+	//Detailed bumpy spheres with the attributes a lit, textured mesh would carry: area weighted normals, spherical UVs
+	std::mt19937 random(1234);
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<unsigned int> indices;
+	size_t triangles = 0, indexBytes = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::vector<glm::vec3> vertices;
+		const MeshView mesh = generateSphere(4, vertices, indices);
+		addBumps(vertices, random);
+		std::vector<glm::vec3> meshNormals(vertices.size(), glm::vec3(0.0f));
+		for (size_t t = 0; t < mesh.triangleCount(); t++)
+		{
+			const glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]] - vertices[indices[t * 3]], vertices[indices[t * 3 + 2]] - vertices[indices[t * 3]]);
+			for (int corner = 0; corner < 3; corner++)
+				meshNormals[indices[t * 3 + corner]] += normal;
+		}
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			const glm::vec3 direction = glm::normalize(vertices[v]);
+			positions.push_back(vertices[v]);
+			normals.push_back(glm::normalize(meshNormals[v]));
+			uvs.push_back(glm::vec2(std::atan2(direction.z, direction.x) / 6.2831853f + 0.5f, std::acos(glm::clamp(direction.y, -1.0f, 1.0f)) / 3.1415927f));
+		}
+		triangles += mesh.triangleCount();
+		indexBytes += indices.size() * MeshBuffer::indexSize(vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+	}
+	const size_t vertexCount = positions.size();
+	std::cout << "Vertex formats for " << count << " meshes, " << vertexCount << " vertices, " << triangles << " triangles" << std::endl;
+	std::cout << "  indices: " << indexBytes << " bytes (32-bit: " << triangles * 3 * sizeof(unsigned int) << ")" << std::endl;
+
+	//Every layout declared once, interleaved, encoded and read back the way GL reads it
+	struct Candidate
+	{
+		VertexFormat::Position position;
+		VertexFormat::Normal normal;
+		VertexFormat::TexCoord uv;
+	};
+	const Candidate candidates[] = {
+		{ VertexFormat::POSITION_FLOAT, VertexFormat::NORMAL_FLOAT, VertexFormat::UV_FLOAT },
+		{ VertexFormat::POSITION_HALF, VertexFormat::NORMAL_OCT16, VertexFormat::UV_UNORM16 },
+		{ VertexFormat::POSITION_SNORM16, VertexFormat::NORMAL_OCT16, VertexFormat::UV_UNORM16 },
+		{ VertexFormat::POSITION_SNORM16, VertexFormat::NORMAL_OCT8, VertexFormat::UV_UNORM8 }
+	};
+	const unsigned int floatStride = VertexLayout().add(0, VertexFormat::POSITION_FLOAT).add(1, VertexFormat::NORMAL_FLOAT).add(2, VertexFormat::UV_FLOAT).stride();
+	size_t outOfBounds = 0;
+	for (const Candidate& candidate : candidates)
+	{
+		VertexLayout layout;
+		layout.add(0, candidate.position).add(1, candidate.normal).add(2, candidate.uv);
+		const unsigned int stride = layout.stride(), positionOffset = layout.offset(0), normalOffset = layout.offset(1), uvOffset = layout.offset(2);
+		std::vector<unsigned char> encoded(vertexCount * stride);
+		const double start = Utility::getTime();
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			VertexFormat::encode(encoded.data() + v * stride + positionOffset, positions[v], candidate.position);
+			VertexFormat::encode(encoded.data() + v * stride + normalOffset, normals[v], candidate.normal);
+			VertexFormat::encode(encoded.data() + v * stride + uvOffset, uvs[v], candidate.uv);
+		}
+		const double encodeMs = (Utility::getTime() - start) * 1000.0;
+
+		float positionError = 0.0f, normalError = 0.0f, uvError = 0.0f;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const glm::vec3 position = VertexFormat::decode(encoded.data() + v * stride + positionOffset, candidate.position);
+			const glm::vec3 normal = VertexFormat::decode(encoded.data() + v * stride + normalOffset, candidate.normal);
+			const glm::vec2 uv = VertexFormat::decode(encoded.data() + v * stride + uvOffset, candidate.uv);
+			positionError = std::max(positionError, glm::length(position - positions[v]));
+			normalError = std::max(normalError, std::atan2(glm::length(glm::cross(normal, normals[v])), glm::dot(normal, normals[v])) * 57.29578f);
+			uvError = std::max(uvError, std::max(std::abs(uv.x - uvs[v].x), std::abs(uv.y - uvs[v].y)));
+		}
+		std::cout << "  " << VertexFormat::name(candidate.position) << " / " << VertexFormat::name(candidate.normal) << " / " << VertexFormat::name(candidate.uv)
+			<< ": " << stride << " bytes per vertex (" << static_cast<float>(floatStride) / stride << "x smaller), encoded in " << encodeMs << " ms, largest error: position "
+			<< positionError << ", normal " << normalError << " degrees, UV " << uvError * 1024.0f << " texels of 1024" << std::endl;
+
+		//Rounding to the nearest step is half a step per component at most; the bumps stay below 0.6, a half float's step there is 2^-11
+		const float positionStep = candidate.position == VertexFormat::POSITION_HALF ? 1.0f / 2048.0f : candidate.position == VertexFormat::POSITION_SNORM16 ? 1.0f / 32767.0f : 0.0f;
+		const float uvStep = candidate.uv == VertexFormat::UV_UNORM16 ? 1.0f / 65535.0f : candidate.uv == VertexFormat::UV_UNORM8 ? 1.0f / 255.0f : 0.0f;
+		outOfBounds += positionError > positionStep * 0.5f * std::sqrt(3.0f) + 1e-6f || uvError > uvStep * 0.5f + 1e-6f ? 1 : 0;
+	}
+	if (outOfBounds > 0)
+	{
+		std::cout << "ERROR::VERTEX_FORMAT::ERROR_ABOVE_BOUND " << outOfBounds << " layouts" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+float distanceToMesh(const glm::vec3& point, const MeshView& mesh)
+{
+	//Closest point on every triangle, the reference for the local measure MeshLod uses
+	double closest = DBL_MAX;
+	for (size_t t = 0; t < mesh.triangleCount(); t++)
+	{
+		const glm::dvec3 nearest = MeshLod::closestPoint(glm::dvec3(point), glm::dvec3(mesh.vertices[mesh.indices[t * 3]]),
+			glm::dvec3(mesh.vertices[mesh.indices[t * 3 + 1]]), glm::dvec3(mesh.vertices[mesh.indices[t * 3 + 2]]));
+		closest = std::min(closest, glm::length(glm::dvec3(point) - nearest));
+	}
+	return static_cast<float>(closest);
+}
+
+bool bruteForceRay(const RayScene& scene, const Ray& worldRay, RayHit& hit)
+{
+	//Every triangle of every instance moved to world space, the reference for the BVH
+	Ray ray = worldRay;
+	hit = RayHit();
+	for (unsigned int instance = 0; instance < scene.instanceCount(); instance++)
+	{
+		const glm::mat4& model = scene.model(instance);
+		const MeshView& view = scene.meshView(scene.mesh(instance));
+		for (unsigned int t = 0; t < view.triangleCount(); t++)
+		{
+			const glm::vec3 v0 = glm::vec3(model * glm::vec4(view.vertices[view.indices[t * 3]], 1.0f));
+			const glm::vec3 v1 = glm::vec3(model * glm::vec4(view.vertices[view.indices[t * 3 + 1]], 1.0f));
+			const glm::vec3 v2 = glm::vec3(model * glm::vec4(view.vertices[view.indices[t * 3 + 2]], 1.0f));
+			if (!RayScene::intersectTriangle(ray, v0, v1, v2))
+				continue;
+			hit.t = ray.tMax;
+			hit.instance = instance;
+			hit.triangle = t;
+		}
+	}
+	return hit.instance != 0xFFFFFFFFu;
+}
@@ -0,0 +1,21 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <cstddef>
+
+// The self-checking benchmarks: each times the CPU paths of one helper on N generated objects,
+// compares them against a reference and returns -1 when they disagree. None needs a GL context.
+// Selected on the command line by flag ("--cull-benchmark N"), main() runs it and exits.
+struct BenchmarkEntry
+{
+	const char* flag;
+	const char* description; // what the usage text prints after "flag N"
+	int (*run)(unsigned int count);
+};
+
+extern const BenchmarkEntry BENCHMARKS[];
+extern const size_t BENCHMARK_COUNT;
+
+// NULL when no benchmark goes by that flag
+const BenchmarkEntry* findBenchmark(const char* flag);
+#endif
@@ -0,0 +1,7 @@
+// Per frame, shared by all programs (UniformBlocks::CAMERA)
+layout (std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+};
@@ -2,5 +2,9 @@
 out vec4 fragColor;
 void main()
 {
+#ifdef WIREFRAME
+    fragColor = vec4(0.3f, 1.0f, 0.5f, 1.0f);
+#else
     fragColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
-}
\ No newline at end of file
+#endif
+}
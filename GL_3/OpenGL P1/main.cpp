@@ -1,44 +1,150 @@
 #include <glad/glad.h>
+#ifndef NO_GLFW
 #include <GLFW/glfw3.h>
+#endif
 #include <iostream>	
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <map>
+#include <random>
 
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <glm/glm/gtc/type_ptr.hpp>
 #include <helpers/shader.h>
+#include <helpers/uniformbuffer.h>
+#include <helpers/shaderwatcher.h>
+#include <helpers/shadervariants.h>
+#include <helpers/shaderbatch.h>
+#include <helpers/meshbuffer.h>
+#include <helpers/meshview.h>
+#include <helpers/meshlod.h>
+#include <helpers/meshoptimizer.h>
+#include <helpers/vertexformat.h>
+#include <helpers/uploadcounter.h>
+#include <helpers/streambuffer.h>
+#include <helpers/instancebuffer.h>
+#include <helpers/drawcommands.h>
+#include <helpers/culling.h>
+#include <helpers/gpuculling.h>
+#include <helpers/depthpyramid.h>
+#include <helpers/gputimer.h>
+#include <helpers/maskedocclusion.h>
+#include <helpers/jobsystem.h>
+#include <helpers/transformbatch.h>
+#include <helpers/scenegraph.h>
+#include <helpers/rayscene.h>
+#include <helpers/framebuffer.h>
+#include <helpers/benchmark.h>
+#include <helpers/framestats.h>
+#ifdef HAS_EGL
+#include <helpers/headless.h>
+#endif
 
 #include <Utility/Utility.h>
-
-struct Shape {
-	std::string name;
-	glm::vec3* vertices;
-	size_t vertexCount;
-	unsigned int* indices;
-	unsigned int indicesSize;
-};
+#include "scene.h"
+#include "benchmarks.h"
 
 // functions
+bool parseArguments(int argc, char** argv);
+bool createContext();
+bool shouldClose();
+void endFrame();
+void destroyContext();
+#ifndef NO_GLFW
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
+#endif
 void CalculateTick();
 
-void setTransform(Shader shader);
-void bind(Shape shape);
+void resolveUniforms(Shader& shader);
+void useVariant(const char* name);
+void shaderReloaded(Shader& shader);
+void setCamera();
+glm::mat4 setTransform(const Shader& shader);
+void drawBounds(const Shape& shape, const glm::mat4& model);
+const Shape& findShape(const char* name);
+void buildShapeLods();
+void uploadShapes();
+MeshBuffer::Mesh addMesh(const MeshView& view);
+void buildStressScene();
+void drawStressScene();
+void buildObjectScene();
+void animateObjectScene();
+void buildObjectGraph(const std::vector<glm::mat4>& transforms);
+void updateObjectGraph();
+void cullObjectScene();
+void drawObjectScene();
+void printOcclusionStats();
+glm::mat4 objectModel(unsigned int object);
+void pickObject(double x, double y);
+void selectObjectLods();
+const MeshBuffer::Mesh& objectMesh(unsigned int object);
 
 // settings
-static int SCREEN_WIDTH = 1600;
-static int SCREEN_HEIGHT = 900;
+int SCREEN_WIDTH = 1600;
+int SCREEN_HEIGHT = 900;
 
 static float MOVE_SPEED = 0.1f;
 static float ROTATION_SPEED = 1.0f;
+#ifndef NO_GLFW
 static float DEADZONE = 0.1f;
+#endif
+
+// run mode
+static bool headless = false;
+static bool benchmark = false;
+static unsigned int frameLimit = 600; // headless and benchmark runs stop after this
+static unsigned int frameCount = 0;
+static std::string benchmarkOutput = "benchmark.csv";
+static unsigned int stressCount = 0; // --stress N, draws N cubes and pyramids instead of one shape
+static unsigned int objectCount = 0; // --objects N, draws N mixed shapes with multi-draw indirect
+static bool directDraws = false; // --direct, the object scene with one draw call per object instead
+static bool frustumCulling = true; // --no-cull, the object scene draws every object
+static bool gpuCulling = false; // --gpu-cull, the object scene is culled by a compute shader and drawn from the buffers it writes
+static bool occlusionCulling = false; // --hiz, --gpu-cull also tests against a depth pyramid of last frame's visible solid objects
+static bool cpuOcclusion = false; // --cpu-occlusion, the near solid objects are rasterized on the CPU and hide what is behind them before drawing
+static bool animateObjects = false; // --animate, every object of the object scene spins, models are recomputed each frame
+static bool objectHierarchy = false; // --graph, the object scene as a scene graph in which every fourth layer turns as a whole
+static bool lodSelection = false; // --lod, every object of the object scene is drawn at the coarsest level of detail that stays within LOD_PIXEL_ERROR
+static bool optimizeMeshes = true; // --no-mesh-opt, meshes are uploaded in authored order instead of reordered for the vertex cache, overdraw and vertex fetch
+static VertexFormat::Position vertexFormat = VertexFormat::POSITION_HALF; // --vertex-format float|half|snorm16, how meshBuffer stores positions, half keeps the shapes' corners exact
+static const BenchmarkEntry* cpuBenchmark = NULL; // --cull-benchmark N or any other flag in BENCHMARKS, runs that benchmark on N objects without a GL context and exits
+static unsigned int cpuBenchmarkCount = 0; // its N
+static unsigned int jobThreads = 0; // --jobs N, threads for per-frame CPU work including the main thread, 0 = one per core
+static const double BENCHMARK_TIMESTEP = 1.0 / 60.0; // fixed scene time, every run renders the same frames
+
+// context
+#ifndef NO_GLFW
+GLFWwindow* window = NULL;
+#endif
+#ifdef HAS_EGL
+HeadlessContext headlessContext;
+#endif
+Framebuffer offscreen; // headless has no default framebuffer, benchmark never presents
+static const unsigned int FRAMES_IN_FLIGHT = 2;
+GLsync frameFences[FRAMES_IN_FLIGHT] = {}; // offscreen runs have no swap to throttle them
+Benchmark benchmarkTimer;
+JobSystem jobs; // per-frame CPU work, tasks end with the frame
 
 // time
 double currentFrameTime = 0;
-double lastFrameTime = 0;
+double lastFrameTime = 0; // set when the render loop starts
 double elapsedTime = 0;
 double deltaTime = 0;
+FrameStats frameStats; // deltaTime history, P prints the percentiles
+
+// uniforms, resolved once after linking
+Uniform<glm::mat4> modelUniform;
+UniformBuffer<CameraBlock> cameraBuffer; // view/projection, once per frame for all programs
+ShaderWatcher shaderWatcher; // hot reload, off while benchmarking so runs stay reproducible
+ShaderVariants shaderVariants; // vert.vs + frag.fs per polygon mode
+Shader* shader = NULL; // active variant
 
 #pragma region Shapes
 
@@ -122,118 +228,571 @@ unsigned int indices_pyramid[] = {
 	3, 0, 4,	//Left
 };
 
+//Sphere
+std::vector<glm::vec3> vertices_sphere;
+std::vector<unsigned int> indices_sphere;
+
 #pragma endregion
 
 Shape shapes[] = {
-	{"triangle", vertices_triangle, sizeof(vertices_triangle), indices_triangle, sizeof(indices_triangle)},
-	{"rectangle", vertices_rectangle, sizeof(vertices_rectangle), indices_rectangle, sizeof(indices_rectangle)},
-	{"cube", vertices_cube, sizeof(vertices_cube), indices_cube, sizeof(indices_cube)},
-	{"pyramid", vertices_pyramid, sizeof(vertices_pyramid), indices_pyramid, sizeof(indices_pyramid)}
+	{"triangle", MeshView(vertices_triangle, indices_triangle)},
+	{"rectangle", MeshView(vertices_rectangle, indices_rectangle)},
+	{"cube", MeshView(vertices_cube, indices_cube)},
+	{"pyramid", MeshView(vertices_pyramid, indices_pyramid)},
+	{"sphere", generateSphere(2, vertices_sphere, indices_sphere)} // detailed enough to need levels of detail
 };
 
 // shape array
 const unsigned int shapeCount = sizeof(shapes) / sizeof(Shape);
+unsigned int objectShapeCount = shapeCount - 1; // the object scene's shapes, the sphere only joins with --lod
 unsigned short shapeIndex = 0;
 bool recalculateShape = true;
 
-unsigned int VAO, VBO, EBO; //Why only define inside main
+MeshBuffer meshBuffer; // every shape, uploaded once
+
+// debug lines, rebuilt every frame
+static const size_t DEBUG_LINE_VERTICES = 4096;
+StreamBuffer debugStream;
+unsigned int debugVAO = 0;
+bool showBounds = false; // B
+
+// camera, moved back for the stress scene
+float cameraDistance = 10.0f;
+float farPlane = 100.0f;
+Frustum cameraFrustum; // planes of the last setCamera(), for culling
+glm::mat4 cameraViewProjection(1.0f); // of the last setCamera(), for picking
 
-	int main()
+// stress scene, half cubes then half pyramids in one instance buffer
+InstanceBuffer instanceBuffer;
+Shader* instancedShader = NULL;
+unsigned int cubeInstances = 0;
+
+// object scene, every shape with its own transform, one bucket per shader/polygon mode
+enum ObjectBucket : unsigned int { SOLID_OBJECTS, WIRE_OBJECTS };
+struct Object
+{
+	const Shape* shape;
+	ObjectBucket bucket;
+};
+std::vector<Object> objects;
+TransformBatch objectTransforms; // same order as objects
+std::vector<glm::mat4> objectModels; // CPU copy for the static upload and for --direct
+static const unsigned int OBJECT_MODEL_BINDING = 1; // "ObjectData" in vert.vs
+unsigned int objectModelBuffer = 0; // every model matrix, static
+StreamBuffer objectStream; // every model matrix, written each frame when animated
+size_t objectStreamAlignment = 1; // storage buffer offset alignment
+JobSystem::Task* objectTransformTask = NULL; // this frame's models are written after it
+SceneGraph objectGraph; // --graph, one group node per layer of the block with its objects below
+std::vector<unsigned int> layerNodes;
+std::vector<unsigned int> objectNodes; // graph node of each object, ObjectData then holds every node
+std::vector<unsigned int> nodeObjects; // object of each node, NO_PARENT for the groups
+std::vector<glm::vec3> shapeCenters, shapeExtents; // local boxes, same order as shapes
+JobSystem::Task* objectGraphTask = NULL; // this frame's world matrices and bounds are updated after it
+unsigned long long graphRecomputed = 0;
+DrawCommands<unsigned int> objectDraws; // per draw only the object index, rebuilt from the visible ones
+Shader* multidrawShaders[2] = {};
+GpuCulling gpuCull; // --gpu-cull, objects grouped into one draw per bucket and mesh
+Shader* gpuCulledShaders[2] = {};
+DepthPyramid depthPyramid; // --hiz
+GpuTimer objectPassTimer; // --gpu-cull, GPU time of the object draws after culling
+CullingBounds objectBounds; // world space boxes, same order as objects
+std::vector<std::vector<unsigned int>> visibleRanges; // per culling job, joined into visibleObjects
+std::vector<unsigned int> visibleObjects;
+JobSystem::Task* objectCommandsTask = NULL; // this frame's visibleObjects and objectDraws are ready after it
+RayScene pickScene; // one instance per object, the moving ones are refit at the first pick of a frame
+unsigned int pickSceneFrame = 0;
+double cullSeconds = 0.0;
+unsigned long long culledFrames = 0, visibleTotal = 0;
+MaskedOcclusion occlusionBuffer; // --cpu-occlusion
+static const unsigned int MAX_OCCLUDERS = 512;
+static const float MIN_OCCLUDER_SIZE = 0.02f; // bounding radius over view depth
+std::vector<unsigned int> occluderObjects, occluderCandidates;
+double occlusionSeconds = 0.0;
+unsigned long long occludedTotal = 0, occluderTriangleTotal = 0;
+float cameraPixelsPerUnit = 1.0f; // pixels one unit covers at view depth 1 with the last setCamera(), for LOD
+std::vector<unsigned char> objectLevels; // --lod, level of detail of every visible object this frame
+unsigned long long lodTriangleTotal = 0, fullTriangleTotal = 0;
+MeshOptimizer::Stats authoredStats, optimizedStats; // triangle weighted sums over every uploaded mesh, headless and benchmark only
+size_t optimizedTriangles = 0;
+double optimizeTime = 0.0; // seconds addMesh() spent reordering
+
+	int main(int argc, char** argv)
 	{
-		// Initialize and configure
-		glfwInit();
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	
-		// GLFW Window creation
-		GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Super cool and epic OpenGL window", NULL, NULL);
-		if (window == NULL)
-		{
-			std::cout << "Failed to create GLFW window" << std::endl;
-			glfwTerminate();
+		if (!parseArguments(argc, argv))
 			return -1;
+		if (jobThreads == 0)
+			jobThreads = std::max(1u, std::thread::hardware_concurrency());
+		jobs.start(jobThreads - 1);
+		if (cpuBenchmark != NULL && cpuBenchmarkCount > 0)
+		{
+			const int result = cpuBenchmark->run(cpuBenchmarkCount);
+			jobs.stop();
+			return result;
 		}
-		glfwMakeContextCurrent(window);
-		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+
+		// Initialize and configure
+		if (!createContext())
+			return -1;
+
+		// Offscreen target
+		if ((headless || benchmark) && !offscreen.create(SCREEN_WIDTH, SCREEN_HEIGHT))
 		{
-			std::cout << "Failed to initialize GLAD" << std::endl;
+			destroyContext();
 			return -1;
 		}
 
-		// Set up viewport resize callback (optional but useful)
-		glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-
 		//Shader setup
-		Shader shader("vert.vs", "frag.fs");
-		shader.use();//Wraps the glUseProgram(shaderProgram) call
+		const double shaderStart = Utility::getTime();
+		shaderVariants.add("fill", "vert.vs", "frag.fs");
+		shaderVariants.add("line", "vert.vs", "frag.fs", { { "WIREFRAME", "" } });
+		shaderVariants.add("point", "vert.vs", "frag.fs", { { "WIREFRAME", "" } }); // same program as "line"
+		if (stressCount > 0)
+			instancedShader = shaderVariants.add("instanced", "vert.vs", "frag.fs", { { "INSTANCED", "" } });
+		if (objectCount > 0)
+		{
+			multidrawShaders[SOLID_OBJECTS] = shaderVariants.add("multidraw", "vert.vs", "frag.fs", { { "MULTIDRAW", "" } });
+			multidrawShaders[WIRE_OBJECTS] = shaderVariants.add("multidraw line", "vert.vs", "frag.fs", { { "MULTIDRAW", "" }, { "WIREFRAME", "" } });
+		}
+		if (objectCount > 0 && gpuCulling)
+		{
+			gpuCulledShaders[SOLID_OBJECTS] = shaderVariants.add("gpu culled", "vert.vs", "frag.fs", { { "GPU_CULLED", "" } });
+			gpuCulledShaders[WIRE_OBJECTS] = shaderVariants.add("gpu culled line", "vert.vs", "frag.fs", { { "GPU_CULLED", "" }, { "WIREFRAME", "" } });
+		}
+		ShaderBatch shaderBatch;
+		shaderVariants.compile(shaderBatch);
+		shaderBatch.submit(); // driver compiles all programs in parallel while the buffers are set up
+		cameraBuffer.create(UniformBlocks::CAMERA);
+		shaderBatch.wait();
+		if (shaderVariants.find("fill") == NULL || shaderBatch.failed() > 0)
+		{
+			destroyContext();
+			return -1;
+		}
+		if (headless || benchmark)
+			std::cout << "Shader setup: " << (Utility::getTime() - shaderStart) * 1000.0 << " ms, " << shaderVariants.variantCount()
+				<< " variants in " << shaderVariants.programCount() << " programs" << std::endl;
+		useVariant("fill");
+		if (!benchmark)
+		{
+			shaderVariants.watch(shaderWatcher, shaderReloaded);
+			shaderWatcher.start();
+		}
 
 		//Draw mode settings
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		glEnable(GL_DEPTH_TEST);
-		glfwSwapInterval(1); // Enable VSync for not crashing my pc
 
-		//Bind Buffers
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-		glBindVertexArray(VAO);
+		//Upload all shapes once, switching is just a different offset, the same for levels of detail
+		if (lodSelection && objectCount > 0)
+			buildShapeLods();
+		uploadShapes();
+		meshBuffer.bind();
 
-		//Shape
-		int size;
-		shapes[shapeIndex];
-		bind(shapes[shapeIndex]);
-		glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);//Call after binding!!!
+		//Debug lines read straight from the stream buffer
+		if (!debugStream.create(DEBUG_LINE_VERTICES * sizeof(glm::vec3)))
+		{
+			destroyContext();
+			return -1;
+		}
+		glGenVertexArrays(1, &debugVAO);
+		glBindVertexArray(debugVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, debugStream.ID);
+		VertexLayout().add(0, VertexFormat::POSITION_FLOAT).apply();
+		meshBuffer.bind();
+
+		//Stress scene
+		if (stressCount > 0)
+			buildStressScene();
+		else if (objectCount > 0)
+			buildObjectScene();
+
+		const unsigned long long setupBytes = UploadCounter::endSetup();
+		if (headless || benchmark)
+			std::cout << "Setup upload: " << setupBytes << " bytes (meshes: " << meshBuffer.vertexCount() << " vertices, "
+				<< meshBuffer.indexCount() << " indices)" << std::endl;
 
 		//Redraw frame
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 
-		while (!glfwWindowShouldClose(window))
+		if (benchmark)
+			benchmarkTimer.create(frameLimit);
+
+		const double startTime = Utility::getTime();
+		lastFrameTime = startTime; // the first frame's delta must not include setup
+		while (!shouldClose())
 		{
+			if (benchmark)
+				benchmarkTimer.beginFrame();
+
+			shaderWatcher.apply();
+			debugStream.beginFrame();
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			CalculateTick();
-			processInput(window);
+#ifndef NO_GLFW
+			if (window != NULL)
+				processInput(window);
+#endif
 
 			if (recalculateShape)
 			{
 				recalculateShape = false;
-				Shape& shape = shapes[shapeIndex];
-				bind(shape);
+				const Shape& shape = shapes[shapeIndex];
 				std::cout << "Shape name: " << shape.name << std::endl;
 				std::cout << "Switched to shape index: " << shapeIndex << std::endl;
-				glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
 			}
 
 			// Set transforms and draw
-			setTransform(shader);
+			setCamera();
+			if (stressCount > 0)
+			{
+				drawStressScene();
+			}
+			else if (objectCount > 0)
+			{
+				if (animateObjects)
+					animateObjectScene();
+				else if (objectHierarchy)
+					updateObjectGraph();
+				if (!gpuCulling)
+					cullObjectScene();
+				drawObjectScene();
+			}
+			else
+			{
+				const glm::mat4 model = setTransform(*shader);
 
-			//glDrawElements(GL_TRIANGLES, shape.indicesSize, GL_UNSIGNED_INT, (void*)0);
-			glDrawElements(GL_TRIANGLES, size / sizeof(GLuint), GL_UNSIGNED_INT, (void*)0);
+				meshBuffer.draw(shapes[shapeIndex].mesh);
+				if (showBounds)
+					drawBounds(shapes[shapeIndex], model);
+			}
+			debugStream.endFrame();
+			jobs.endFrame();
 
-			glfwSwapBuffers(window);
-			glfwPollEvents();
+			if (benchmark)
+				benchmarkTimer.endFrame(UploadCounter::frameBytes());
+			endFrame();
+		}
+
+		// Timings export
+		if (benchmark)
+		{
+			benchmarkTimer.finish();
+			benchmarkTimer.printSummary();
+			if (benchmarkTimer.write(benchmarkOutput, reinterpret_cast<const char*>(glGetString(GL_RENDERER))))
+				std::cout << "Frame times written to " << benchmarkOutput << std::endl;
+			benchmarkTimer.destroy();
+		}
+
+		shaderWatcher.stop();
+		jobs.stop();
+		cameraBuffer.destroy();
+		meshBuffer.destroy();
+		instanceBuffer.destroy();
+		objectDraws.destroy();
+		glDeleteBuffers(1, &objectModelBuffer);
+		objectStream.destroy();
+		glDeleteVertexArrays(1, &debugVAO);
+		debugStream.destroy();
+
+		// Throughput summary
+		if (headless || benchmark)
+		{
+			glFinish();
+			const double seconds = Utility::getTime() - startTime;
+			std::cout << "Rendered " << frameCount << " frames in " << seconds << " s (" << frameCount / seconds << " fps)" << std::endl;
+			if (stressCount > 0)
+			{
+				const double instancesPerSecond = static_cast<double>(stressCount) * frameCount / seconds;
+				const double trianglesPerInstance = static_cast<double>(findShape("cube").view.triangleCount() + findShape("pyramid").view.triangleCount()) / 2.0;
+				std::cout << "Stress: " << stressCount << " instances, " << instancesPerSecond / 1e6 << " M instances/s, "
+					<< instancesPerSecond * trianglesPerInstance / 1e6 << " M triangles/s" << std::endl;
+			}
+			if (objectCount > 0 && culledFrames > 0)
+			{
+				std::cout << "Culling (" << FrustumCulling::path() << "): " << cullSeconds * 1000.0 / culledFrames << " ms per frame, "
+					<< visibleTotal / culledFrames << " of " << objectCount << " objects visible on average" << std::endl;
+				if (objectHierarchy)
+					std::cout << "Scene graph: " << objectGraph.size() << " nodes, " << graphRecomputed / culledFrames
+						<< " world matrices recomputed per frame on average" << std::endl;
+				if (cpuOcclusion)
+					std::cout << "CPU occlusion (" << MaskedOcclusion::path() << ", " << occlusionBuffer.width() << "x" << occlusionBuffer.height() << "): "
+						<< occlusionSeconds * 1000.0 / culledFrames << " ms per frame, " << occluderTriangleTotal / culledFrames << " occluder triangles and "
+						<< occludedTotal / culledFrames << " objects hidden per frame on average" << std::endl;
+				if (lodSelection)
+					std::cout << "Levels of detail (" << LOD_PIXEL_ERROR << " px): " << lodTriangleTotal / culledFrames << " of " << fullTriangleTotal / culledFrames
+						<< " triangles of the visible objects drawn per frame on average" << std::endl;
+			}
+			if (objectCount > 0 && gpuCulling)
+			{
+				//Same frustum and boxes on the CPU, the counts should agree up to rounding at the planes
+				CullingBounds bounds;
+				bounds.resize(objectCount);
+				for (unsigned int i = 0; i < objectCount; i++)
+				{
+					glm::vec3 low, high;
+					localBounds(*objects[i].shape, low, high);
+					bounds.set(i, objectModel(i), (low + high) * 0.5f, (high - low) * 0.5f);
+				}
+				std::vector<unsigned int> visible;
+				FrustumCulling::cullBoxes(cameraFrustum, bounds, visible);
+				std::cout << "GPU culling: " << gpuCull.averageMs() << " ms per frame on the GPU, " << gpuCull.readVisible() << " of " << objectCount
+					<< " objects visible in the last frame (CPU: " << visible.size() << "), " << gpuCull.drawCount() << " indirect draws" << std::endl;
+				printOcclusionStats();
+			}
+			frameStats.print();
+			UploadCounter::print();
+			jobs.printStats();
+			std::cout << "Stream buffer waits: " << debugStream.stalls() + objectStream.stalls() << std::endl;
+			for (GLsync& fence : frameFences)
+			{
+				glDeleteSync(fence);
+				fence = NULL;
+			}
+			offscreen.destroy();
 		}
+		gpuCull.destroy();
+		depthPyramid.destroy();
+		objectPassTimer.destroy();
 
-	glfwTerminate();
+	destroyContext();
 	return 0;
 }
 
+bool parseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmark = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frameLimit = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			benchmarkOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bounds") == 0)
+		{
+			showBounds = true;
+		}
+		else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+		{
+			stressCount = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+		}
+		else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+		{
+			objectCount = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+		}
+		else if (strcmp(argv[i], "--direct") == 0)
+		{
+			directDraws = true;
+		}
+		else if (strcmp(argv[i], "--no-cull") == 0)
+		{
+			frustumCulling = false;
+		}
+		else if (strcmp(argv[i], "--gpu-cull") == 0)
+		{
+			gpuCulling = true;
+		}
+		else if (strcmp(argv[i], "--hiz") == 0)
+		{
+			gpuCulling = true;
+			occlusionCulling = true;
+		}
+		else if (strcmp(argv[i], "--animate") == 0)
+		{
+			animateObjects = true;
+		}
+		else if (strcmp(argv[i], "--graph") == 0)
+		{
+			objectHierarchy = true;
+		}
+		else if (strcmp(argv[i], "--cpu-occlusion") == 0)
+		{
+			cpuOcclusion = true;
+		}
+		else if (strcmp(argv[i], "--lod") == 0)
+		{
+			lodSelection = true;
+		}
+		else if (strcmp(argv[i], "--no-mesh-opt") == 0)
+		{
+			optimizeMeshes = false;
+		}
+		else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "float") == 0 || strcmp(argv[i + 1], "half") == 0 || strcmp(argv[i + 1], "snorm16") == 0))
+		{
+			i++;
+			vertexFormat = strcmp(argv[i], "float") == 0 ? VertexFormat::POSITION_FLOAT : strcmp(argv[i], "half") == 0 ? VertexFormat::POSITION_HALF : VertexFormat::POSITION_SNORM16;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+		{
+			jobThreads = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+		}
+		else if (findBenchmark(argv[i]) != NULL && i + 1 < argc)
+		{
+			cpuBenchmark = findBenchmark(argv[i]);
+			cpuBenchmarkCount = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--headless] [--benchmark] [--frames N] [--output file.csv|file.json] [--bounds] [--stress N]"
+				<< " [--objects N [--direct | --gpu-cull | --hiz | --cpu-occlusion] [--no-cull] [--animate | --graph] [--lod]]"
+				<< " [--no-mesh-opt] [--vertex-format float|half|snorm16] [--jobs N] [--<name>-benchmark N]" << std::endl;
+			for (size_t b = 0; b < BENCHMARK_COUNT; b++)
+				std::cout << "  " << BENCHMARKS[b].flag << " N: " << BENCHMARKS[b].description << ", then exits" << std::endl;
+			return false;
+		}
+	}
+	if (animateObjects && objectHierarchy)
+	{
+		std::cout << "--animate and --graph are two ways to move the object scene, pick one" << std::endl;
+		return false;
+	}
+	if (gpuCulling && (directDraws || !frustumCulling))
+	{
+		std::cout << "--gpu-cull and --hiz cull and draw the object scene from GPU buffers, they need neither --direct nor --no-cull" << std::endl;
+		return false;
+	}
+	if (cpuOcclusion && (gpuCulling || !frustumCulling))
+	{
+		std::cout << "--cpu-occlusion works on what CPU frustum culling leaves, it goes with neither --gpu-cull, --hiz nor --no-cull" << std::endl;
+		return false;
+	}
+	if (lodSelection && gpuCulling)
+	{
+		std::cout << "--lod picks levels while the draws are built on the CPU, --gpu-cull and --hiz build them on the GPU" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool createContext()
+{
+	if (headless)
+	{
+#ifdef HAS_EGL
+		if (!headlessContext.create(4, 4))
+		{
+			std::cout << "Failed to create headless EGL context" << std::endl;
+			return false;
+		}
+		if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			headlessContext.destroy();
+			return false;
+		}
+		std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+		return true;
+#else
+		std::cout << "Headless mode needs EGL, this build has none" << std::endl;
+		return false;
+#endif
+	}
+
+#ifndef NO_GLFW
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	// GLFW Window creation
+	window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Super cool and epic OpenGL window", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+
+	// Set up viewport resize callback (optional but useful)
+	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+	glfwSwapInterval(benchmark ? 0 : 1); // Enable VSync for not crashing my pc (off while benchmarking)
+	return true;
+#else
+	std::cout << "Built without GLFW, run with --headless" << std::endl;
+	return false;
+#endif
+}
+
+bool shouldClose()
+{
+	if (headless || benchmark)
+		return frameCount >= frameLimit;
+#ifndef NO_GLFW
+	return glfwWindowShouldClose(window);
+#else
+	return true;
+#endif
+}
+
+void endFrame()
+{
+	// Without a swap the driver lets the CPU queue up thousands of frames and then
+	// stalls for seconds at once, so wait like a swap chain would
+	if (headless || benchmark)
+	{
+		GLsync& fence = frameFences[frameCount % FRAMES_IN_FLIGHT];
+		if (fence != NULL)
+		{
+			//A frame slower than the timeout is waited out too, or the throttle would stop
+			GLenum result = GL_TIMEOUT_EXPIRED;
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			if (result == GL_WAIT_FAILED)
+				std::cout << "ERROR::FRAME::FENCE_WAIT_FAILED" << std::endl;
+			glDeleteSync(fence);
+		}
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	frameCount++;
+	UploadCounter::endFrame();
+#ifndef NO_GLFW
+	if (window != NULL)
+	{
+		if (!benchmark)
+			glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+#endif
+}
+
+void destroyContext()
+{
+#ifdef HAS_EGL
+	headlessContext.destroy();
+#endif
+#ifndef NO_GLFW
+	if (window != NULL)
+		glfwTerminate();
+#endif
+}
+
 void CalculateTick()
 {
-	const double currentFrameTime = glfwGetTime();
+	const double currentFrameTime = Utility::getTime();
 	deltaTime = currentFrameTime - lastFrameTime;
 	lastFrameTime = currentFrameTime;
-	elapsedTime += deltaTime;
+	elapsedTime += benchmark ? BENCHMARK_TIMESTEP : deltaTime;
+	frameStats.push(static_cast<float>(deltaTime * 1000.0));
 }
 
-static bool upKeyPressed = false;
-static bool spaceKeyPressed = false;
-static bool downKeyPressed = false;
 static bool leftShiftKeyPressed = false;
-
-static bool gButtonDpadUpPressed = false;
-static bool gButtonDpadDownPressed = false;
-static bool gButtonGuidePressed = false;
 static bool gButtonRighBumperPressed = false;
 
 static bool manualControl = false;
@@ -244,6 +803,18 @@ float leftStickY = 0.0f;
 float rightStickX = 0.0f;
 float rightStickY = 0.0f;
 
+#ifndef NO_GLFW
+static bool upKeyPressed = false;
+static bool spaceKeyPressed = false;
+static bool downKeyPressed = false;
+static bool pKeyPressed = false;
+static bool bKeyPressed = false;
+static bool leftMousePressed = false;
+
+static bool gButtonDpadUpPressed = false;
+static bool gButtonDpadDownPressed = false;
+static bool gButtonGuidePressed = false;
+
 void processInput(GLFWwindow* window)
 {
 	// Toggle manual mode
@@ -263,18 +834,62 @@ void processInput(GLFWwindow* window)
 		glfwSetWindowShouldClose(window, true);
 	}
 
+	// Frame time percentiles
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pKeyPressed)
+	{
+		pKeyPressed = true;
+		frameStats.print();
+		UploadCounter::print();
+		if (objectCount > 0 && gpuCulling)
+			printOcclusionStats();
+	}
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+	{
+		pKeyPressed = false;
+	}
+
+	// Bounding box
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bKeyPressed)
+	{
+		bKeyPressed = true;
+		showBounds = !showBounds;
+	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+	{
+		bKeyPressed = false;
+	}
+
+	// Pick the object under the cursor
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !leftMousePressed)
+	{
+		leftMousePressed = true;
+		double x = 0.0, y = 0.0;
+		int width = 0, height = 0;
+		glfwGetCursorPos(window, &x, &y);
+		glfwGetWindowSize(window, &width, &height);
+		if (objectCount > 0 && width > 0 && height > 0)
+			pickObject(x / width, y / height);
+	}
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
+	{
+		leftMousePressed = false;
+	}
+
 	// Wireframe options
 	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
 	{
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		useVariant("fill");
 	}
 	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
 	{
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		useVariant("line");
 	}
 	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
 	{
 		glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+		useVariant("point");
 	}
 
 	// Scrolling trough meshes
@@ -291,7 +906,7 @@ void processInput(GLFWwindow* window)
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && !downKeyPressed)
 	{
 		downKeyPressed = true;
-		shapeIndex = (shapeIndex - 1) % shapeCount;
+		shapeIndex = (shapeIndex + shapeCount - 1) % shapeCount;
 		recalculateShape = true;
 	}
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_RELEASE)
@@ -350,14 +965,17 @@ void processInput(GLFWwindow* window)
 			if (state.buttons[GLFW_GAMEPAD_BUTTON_A] == GLFW_PRESS)
 			{
 				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				useVariant("fill");
 			}
 			if (state.buttons[GLFW_GAMEPAD_BUTTON_B] == GLFW_PRESS)
 			{
 				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				useVariant("line");
 			}
 			if (state.buttons[GLFW_GAMEPAD_BUTTON_X] == GLFW_PRESS)
 			{
 				glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+				useVariant("point");
 			}
 
 			// Scrolling trough meshes
@@ -412,17 +1030,54 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
 }
+#endif
 
 
-void setTransform(Shader shader)
+void resolveUniforms(Shader& shader)
+{
+	shader.use();//Wraps the glUseProgram(shaderProgram) call
+	modelUniform = shader.uniform<glm::mat4>("model");
+}
+
+void useVariant(const char* name)
+{
+	Shader* variant = shaderVariants.find(name);
+	if (variant == NULL || variant == shader)
+		return;
+	shader = variant;
+	resolveUniforms(*shader);
+}
+
+void shaderReloaded(Shader& reloaded)
+{
+	if (&reloaded == shader)
+		resolveUniforms(reloaded);
+}
+
+void setCamera()
 {
 	const float aspect = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
 	float fov = 90.0f;
 
+	if (manualControl)
+		fov = (leftShiftKeyPressed || gButtonRighBumperPressed) ? 45.0f : 90.0f;
+	else
+		fov = glm::mix(45.0f, 90.0f, Utility::sinPos(elapsedTime) * 0.5f); //mix == slerp
+
+	CameraBlock camera;
+	camera.view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -cameraDistance));
+	camera.projection = glm::perspective(glm::radians(fov), aspect, 0.1f, farPlane);
+	camera.viewProjection = camera.projection * camera.view;
+	cameraFrustum = Frustum::fromMatrix(camera.viewProjection);
+	cameraViewProjection = camera.viewProjection;
+	cameraPixelsPerUnit = camera.projection[1][1] * 0.5f * static_cast<float>(SCREEN_HEIGHT);
+	cameraBuffer.update(camera);
+}
+
+glm::mat4 setTransform(const Shader& shader)
+{
 	//Matrices
 	glm::mat4 model = glm::mat4(1.0f);
-	glm::mat4 view = glm::mat4(1.0f);
-	glm::mat4 projection = glm::mat4(1.0f);
 
 	glm::mat4 t, r, s;
 	s = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
@@ -435,7 +1090,6 @@ void setTransform(Shader shader)
 		const glm::mat4 rotX = glm::rotate(glm::mat4(1.0f), glm::radians(rightStickY * ROTATION_SPEED), glm::vec3(1, 0, 0));
 		const glm::mat4 rotY = glm::rotate(glm::mat4(1.0f), glm::radians(rightStickX * ROTATION_SPEED), glm::vec3(0, 1, 0));
 		r = rotY * rotX;
-		fov = (leftShiftKeyPressed || gButtonRighBumperPressed) ? 45.0f : 90.0f;
 	}
 	else
 	{
@@ -443,17 +1097,672 @@ void setTransform(Shader shader)
 		float autoX = glm::mix(-1.0f, 1.0f, Utility::sinPos(elapsedTime * 0.5f));
 		t = glm::translate(glm::mat4(1.0f), glm::vec3(autoX, 0.0f, 3.0f));
 		r = glm::rotate(model, glm::radians(static_cast<float>(elapsedTime * 45.0)), glm::vec3(1, 1, 1));
-
-		fov = glm::mix(45.0f, 90.0f, Utility::sinPos(elapsedTime) * 0.5f); //mix == slerp
 	}
 	model = t * r * s;
 
-	view = glm::translate(view, glm::vec3(0.0f, 0.0f, -10.0f));
-	projection = glm::perspective(glm::radians(fov), aspect, 0.1f, 100.0f);
+	shader.set(modelUniform, model);
+	return model;
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
-	shader.setMat4("projection", projection);
+const Shape& findShape(const char* name)
+{
+	for (const Shape& shape : shapes)
+	{
+		if (shape.name == name)
+			return shape;
+	}
+	return shapes[0];
+}
+
+std::vector<glm::mat4> gridTransforms(unsigned int count)
+{
+	//Grid of side^3 cells, every cell gets its own fixed rotation
+	const unsigned int side = static_cast<unsigned int>(std::ceil(std::cbrt(static_cast<double>(count))));
+	const float spacing = 1.5f;
+	const float extent = side * spacing;
+	const glm::vec3 origin(-0.5f * extent + 0.5f * spacing);
+
+	std::vector<glm::mat4> transforms(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const glm::vec3 cell(static_cast<float>(i % side), static_cast<float>(i / side % side), static_cast<float>(i / (side * side)));
+		const float angle = static_cast<float>(i % 360);
+		const glm::mat4 t = glm::translate(glm::mat4(1.0f), origin + cell * spacing);
+		const glm::mat4 r = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::normalize(glm::vec3(1.0f, 1.0f + (i % 7), 1.0f)));
+		transforms[i] = t * r;
+	}
+
+	//Back off until the whole block fits
+	cameraDistance = extent * 1.8f;
+	farPlane = cameraDistance + extent * 2.0f;
+	return transforms;
+}
+
+MeshView generateSphere(unsigned int subdivisions, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+	//Icosahedron, then every triangle split in four with the new corners pushed out onto the sphere
+	const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+	vertices = {
+		glm::vec3(-1.0f, t, 0.0f), glm::vec3(1.0f, t, 0.0f), glm::vec3(-1.0f, -t, 0.0f), glm::vec3(1.0f, -t, 0.0f),
+		glm::vec3(0.0f, -1.0f, t), glm::vec3(0.0f, 1.0f, t), glm::vec3(0.0f, -1.0f, -t), glm::vec3(0.0f, 1.0f, -t),
+		glm::vec3(t, 0.0f, -1.0f), glm::vec3(t, 0.0f, 1.0f), glm::vec3(-t, 0.0f, -1.0f), glm::vec3(-t, 0.0f, 1.0f)
+	};
+	indices = {
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+	for (glm::vec3& vertex : vertices)
+		vertex = glm::normalize(vertex);
+	for (unsigned int s = 0; s < subdivisions; s++)
+	{
+		//One new vertex per edge, shared by both triangles on it
+		std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+		auto midpoint = [&](unsigned int a, unsigned int b)
+		{
+			const std::pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+			auto found = midpoints.find(edge);
+			if (found != midpoints.end())
+				return found->second;
+			vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+			return midpoints[edge] = static_cast<unsigned int>(vertices.size() - 1);
+		};
+		std::vector<unsigned int> split;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			const unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			split.insert(split.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+		}
+		indices.swap(split);
+	}
+	//Same size as the other shapes
+	for (glm::vec3& vertex : vertices)
+		vertex *= 0.5f;
+	return MeshView(Span<const glm::vec3>(vertices.data(), vertices.size()), Span<const unsigned int>(indices.data(), indices.size()));
+}
+
+void buildShapeLods()
+{
+	//Every chain only reads its own shape, so each shape is a job of its own
+	const double start = Utility::getTime();
+	jobs.parallelFor(shapeCount, 1, [](size_t first, size_t end)
+	{
+		for (size_t i = first; i < end; i++)
+			shapes[i].lod.build(shapes[i].view, LOD_MAX_ERROR);
+	});
+	std::cout << "Levels of detail: " << (Utility::getTime() - start) * 1000.0 << " ms,";
+	for (const Shape& shape : shapes)
+	{
+		std::cout << " " << shape.name;
+		for (size_t level = 0; level < shape.lod.levels.size(); level++)
+			std::cout << (level == 0 ? " " : "/") << shape.lod.levels[level].triangleCount();
+	}
+	std::cout << " triangles" << std::endl;
+}
+
+void uploadShapes()
+{
+	for (Shape& shape : shapes)
+	{
+		shape.mesh = addMesh(shape.view);
+		shape.lodMeshes.assign(1, shape.mesh);
+		for (size_t level = 1; level < shape.lod.levels.size(); level++)
+			shape.lodMeshes.push_back(addMesh(shape.lod.levels[level].view()));
+	}
+	meshBuffer.upload(vertexFormat);
+	if (headless || benchmark)
+	{
+		//What the same meshes would take as float positions and 32-bit indices
+		size_t shortMeshes = 0, meshCount = 0;
+		for (const Shape& shape : shapes)
+		{
+			for (const MeshBuffer::Mesh& mesh : shape.lodMeshes)
+			{
+				shortMeshes += mesh.indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+				meshCount++;
+			}
+		}
+		std::cout << "Vertex format: " << VertexFormat::name(meshBuffer.vertexFormat()) << " positions, " << meshBuffer.layout.stride() << " bytes per vertex, 16-bit indices for "
+			<< shortMeshes << " of " << meshCount << " meshes, " << meshBuffer.vertexBytes() + meshBuffer.indexBytes() << " bytes (float and 32-bit: "
+			<< meshBuffer.vertexCount() * sizeof(glm::vec3) + meshBuffer.indexCount() * sizeof(unsigned int) << ")" << std::endl;
+	}
+	if (optimizeMeshes && (headless || benchmark))
+	{
+		const float triangles = static_cast<float>(optimizedTriangles);
+		std::cout << "Mesh optimization: " << optimizeTime * 1000.0 << " ms for " << optimizedTriangles << " triangles, ACMR " << authoredStats.acmr / triangles
+			<< " -> " << optimizedStats.acmr / triangles << ", ATVR " << authoredStats.atvr / triangles << " -> " << optimizedStats.atvr / triangles
+			<< ", overdraw " << authoredStats.overdraw / triangles << " -> " << optimizedStats.overdraw / triangles
+			<< ", overfetch " << authoredStats.overfetch / triangles << " -> " << optimizedStats.overfetch / triangles << std::endl;
+	}
+}
+
+MeshBuffer::Mesh addMesh(const MeshView& view)
+{
+	//meshBuffer keeps its own copy, the reordered one only has to live until add() returns
+	if (!optimizeMeshes)
+		return meshBuffer.add(view);
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+	const double start = Utility::getTime();
+	MeshOptimizer::optimize(view, vertices, indices);
+	optimizeTime += Utility::getTime() - start;
+	const MeshView optimized(Span<const glm::vec3>(vertices.data(), vertices.size()), Span<const unsigned int>(indices.data(), indices.size()));
+
+	//Only measured when printed, the overdraw views rasterize every triangle six times
+	if (headless || benchmark)
+	{
+		const MeshOptimizer::Stats before = MeshOptimizer::analyze(view), after = MeshOptimizer::analyze(optimized);
+		const float triangles = static_cast<float>(view.triangleCount());
+		authoredStats.acmr += before.acmr * triangles;
+		authoredStats.atvr += before.atvr * triangles;
+		authoredStats.overdraw += before.overdraw * triangles;
+		authoredStats.overfetch += before.overfetch * triangles;
+		optimizedStats.acmr += after.acmr * triangles;
+		optimizedStats.atvr += after.atvr * triangles;
+		optimizedStats.overdraw += after.overdraw * triangles;
+		optimizedStats.overfetch += after.overfetch * triangles;
+		optimizedTriangles += view.triangleCount();
+	}
+	return meshBuffer.add(optimized);
+}
+
+void buildStressScene()
+{
+	const std::vector<glm::mat4> transforms = gridTransforms(stressCount);
+	cubeInstances = stressCount / 2;
+
+	instanceBuffer.create(Span<const glm::mat4>(transforms.data(), transforms.size()));
+	instanceBuffer.attach(meshBuffer.VAO);
+	std::cout << "Stress scene: " << cubeInstances << " cubes, " << stressCount - cubeInstances << " pyramids" << std::endl;
+}
+
+void drawStressScene()
+{
+	instancedShader->use();
+	meshBuffer.drawInstanced(findShape("cube").mesh, cubeInstances, 0);
+	meshBuffer.drawInstanced(findShape("pyramid").mesh, stressCount - cubeInstances, cubeInstances);
+}
+
+void buildObjectScene()
+{
+	//Every shape in turn, every fifth one as wireframe, spheres only when they get levels of detail
+	if (lodSelection)
+		objectShapeCount = shapeCount;
+	const std::vector<glm::mat4> transforms = gridTransforms(objectCount);
+	objects.resize(objectCount);
+	objectBounds.resize(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		objects[i].shape = &shapes[i % objectShapeCount];
+		objects[i].bucket = i % 5 == 4 ? WIRE_OBJECTS : SOLID_OBJECTS;
+		objectTransforms.add(glm::vec3(transforms[i][3]), glm::quat_cast(glm::mat3(transforms[i])));
+
+		//Spinning objects get a box that holds every rotation, so the bounds never change
+		glm::vec3 low, high;
+		localBounds(*objects[i].shape, low, high);
+		const glm::vec3 center = (low + high) * 0.5f, extent = (high - low) * 0.5f;
+		if (animateObjects)
+			objectBounds.set(i, glm::translate(glm::mat4(1.0f), glm::vec3(transforms[i][3])), glm::vec3(0.0f), glm::vec3(glm::length(center) + glm::length(extent)));
+		else
+			objectBounds.set(i, transforms[i], center, extent);
+	}
+	objectModels.resize(objectCount);
+	objectTransforms.compute(0, objectCount, objectModels.data());
+	if (objectHierarchy)
+		buildObjectGraph(transforms);
+
+	//Ray casts for picking, one mesh per shape
+	for (const Shape& shape : shapes)
+		pickScene.addMesh(shape.view);
+	for (unsigned int i = 0; i < objectCount; i++)
+		pickScene.addInstance(static_cast<unsigned int>(objects[i].shape - shapes), objectModels[i]);
+	pickScene.build(&jobs);
+
+	//Camera close to the front face of the block, so part of it is beside or behind the view
+	cameraDistance *= 0.3f;
+
+	//The draws only carry the object index, the models are uploaded once or streamed every frame
+	if (animateObjects && !directDraws)
+	{
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		objectStreamAlignment = std::max(alignment, 1);
+		if (!objectStream.create(objectModels.size() * sizeof(glm::mat4) + objectStreamAlignment))
+			animateObjects = false;
+	}
+	else if (objectHierarchy && !directDraws)
+	{
+		glGenBuffers(1, &objectModelBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectModelBuffer);
+		UploadCounter::bufferStorage(GL_SHADER_STORAGE_BUFFER, objectGraph.size() * sizeof(glm::mat4), objectGraph.worldData(), GL_DYNAMIC_STORAGE_BIT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_MODEL_BINDING, objectModelBuffer);
+	}
+	else if (!directDraws)
+	{
+		glGenBuffers(1, &objectModelBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectModelBuffer);
+		UploadCounter::bufferStorage(GL_SHADER_STORAGE_BUFFER, objectModels.size() * sizeof(glm::mat4), objectModels.data(), 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_MODEL_BINDING, objectModelBuffer);
+	}
+
+	//Everything the compute pass needs stays on the GPU, only the frustum changes per frame
+	if (gpuCulling && gpuCull.create("cull.comp"))
+	{
+		for (unsigned int i = 0; i < objectCount; i++)
+		{
+			glm::vec3 low, high;
+			localBounds(*objects[i].shape, low, high);
+			gpuCull.add(objects[i].bucket, objects[i].shape->mesh, objectHierarchy ? objectNodes[i] : i, (low + high) * 0.5f, (high - low) * 0.5f);
+		}
+		gpuCull.upload();
+		objectPassTimer.create();
+	}
+	else
+	{
+		gpuCulling = false;
+	}
+	if (gpuCulling && occlusionCulling && !depthPyramid.create(SCREEN_WIDTH, SCREEN_HEIGHT, "hiz.comp"))
+		occlusionCulling = false;
+	occlusionCulling = occlusionCulling && gpuCulling;
+
+	if (cpuOcclusion)
+		occlusionBuffer.resize(OCCLUSION_WIDTH, OCCLUSION_WIDTH * SCREEN_HEIGHT / SCREEN_WIDTH);
+	if (lodSelection)
+		objectLevels.assign(objectCount, 0);
+
+	objectDraws.create();
+	std::cout << "Object scene: " << objectCount << (animateObjects ? " spinning" : objectHierarchy ? " layered" : " static") << " objects, "
+		<< (occlusionCulling ? "frustum and occlusion culled on the GPU" : gpuCulling ? "frustum culled on the GPU" : cpuOcclusion ? "frustum and occlusion culled" : frustumCulling ? "frustum culled" : "not culled") << ", " << (directDraws ? "one call per object" : "one multi-draw call per bucket") << (lodSelection ? ", levels of detail" : "") << std::endl;
+}
+
+void buildObjectGraph(const std::vector<glm::mat4>& transforms)
+{
+	//Local boxes per shape, the bounds of moved objects are rebuilt from them
+	for (const Shape& shape : shapes)
+	{
+		glm::vec3 low, high;
+		localBounds(shape, low, high);
+		shapeCenters.push_back((low + high) * 0.5f);
+		shapeExtents.push_back((high - low) * 0.5f);
+	}
+
+	//gridTransforms() fills the block layer by layer along z, so every layer is one subtree
+	const unsigned int side = static_cast<unsigned int>(std::ceil(std::cbrt(static_cast<double>(objectCount))));
+	objectNodes.resize(objectCount);
+	for (unsigned int first = 0; first < objectCount; first += side * side)
+	{
+		const glm::mat4 layer = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, transforms[first][3].z));
+		const glm::mat4 toLayer = glm::inverse(layer);
+		layerNodes.push_back(objectGraph.add(SceneGraph::NO_PARENT, layer));
+		nodeObjects.push_back(SceneGraph::NO_PARENT);
+		for (unsigned int i = first; i < std::min(first + side * side, objectCount); i++)
+		{
+			objectNodes[i] = objectGraph.add(layerNodes.back(), toLayer * transforms[i]);
+			nodeObjects.push_back(i);
+		}
+	}
+}
+
+void updateObjectGraph()
+{
+	//Every fourth layer turns around the axis of the block, the others are static and cost nothing
+	const float angle = glm::radians(30.0f) * static_cast<float>(elapsedTime);
+	for (size_t layer = 0; layer < layerNodes.size(); layer += 4)
+	{
+		const glm::mat4& local = objectGraph.local(layerNodes[layer]);
+		objectGraph.setLocal(layerNodes[layer], glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(local[3])), angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+	}
+
+	objectGraphTask = jobs.add([]()
+	{
+		graphRecomputed += objectGraph.update();
+		for (const SceneGraph::Range& range : objectGraph.changedRanges())
+		{
+			for (unsigned int node = range.first; node < range.second; node++)
+			{
+				const unsigned int object = nodeObjects[node];
+				if (object == SceneGraph::NO_PARENT)
+					continue;
+				const size_t shape = objects[object].shape - shapes;
+				objectBounds.set(object, objectGraph.world(node), shapeCenters[shape], shapeExtents[shape]);
+			}
+		}
+	});
+}
+
+void animateObjectScene()
+{
+	//Models go straight into this frame's region of the stream buffer (or the CPU copy for --direct)
+	objectTransformTask = NULL;
+	glm::mat4* models = objectModels.data();
+	if (!directDraws)
+	{
+		size_t offset = 0;
+		objectStream.beginFrame();
+		models = static_cast<glm::mat4*>(objectStream.allocate(objects.size() * sizeof(glm::mat4), objectStreamAlignment, offset));
+		if (models == NULL)
+			return;
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_MODEL_BINDING, objectStream.ID, offset, objects.size() * sizeof(glm::mat4));
+	}
+
+	const float step = static_cast<float>(benchmark ? BENCHMARK_TIMESTEP : deltaTime);
+	const glm::quat spin = glm::angleAxis(glm::radians(90.0f) * step, glm::vec3(0.0f, 1.0f, 0.0f));
+	objectTransformTask = jobs.add([models, spin]()
+	{
+		jobs.parallelFor(objects.size(), 1024, [models, spin](size_t first, size_t end)
+		{
+			objectTransforms.rotate(first, end, spin);
+			objectTransforms.compute(first, end, models + first);
+		});
+	});
+}
+
+void cullObjectScene()
+{
+	//Culling jobs write their own lists, so no locking and the joined list stays in object order
+	JobSystem::Task* cull = jobs.add([]()
+	{
+		const double start = Utility::getTime();
+		visibleRanges.resize((objects.size() + CULL_RANGE - 1) / CULL_RANGE);
+		jobs.parallelFor(visibleRanges.size(), 1, [](size_t first, size_t end)
+		{
+			for (size_t range = first; range < end; range++)
+			{
+				const size_t begin = range * CULL_RANGE;
+				const size_t finish = std::min(begin + CULL_RANGE, objects.size());
+				std::vector<unsigned int>& visible = visibleRanges[range];
+				if (frustumCulling)
+				{
+					FrustumCulling::cullBoxes(cameraFrustum, objectBounds, begin, finish, visible);
+					continue;
+				}
+				visible.resize(finish - begin);
+				for (size_t i = begin; i < finish; i++)
+					visible[i - begin] = static_cast<unsigned int>(i);
+			}
+		});
+		cullSeconds += Utility::getTime() - start;
+	}, { objectGraphTask });
+
+	//The largest solid objects on screen are drawn into occlusionBuffer, then everything left is tested against it
+	if (cpuOcclusion)
+	{
+		cull = jobs.add([]()
+		{
+			const double start = Utility::getTime();
+			occluderCandidates.clear();
+			for (const std::vector<unsigned int>& visible : visibleRanges)
+			{
+				for (unsigned int index : visible)
+				{
+					if (objects[index].bucket == SOLID_OBJECTS)
+						occluderCandidates.push_back(index);
+				}
+			}
+			chooseOccluders(occluderCandidates, objectBounds, cameraViewProjection, occluderObjects);
+			occlusionBuffer.begin(cameraViewProjection);
+			for (unsigned int index : occluderObjects)
+				occlusionBuffer.add(objects[index].shape->view, objectModel(index));
+			occlusionBuffer.render(&jobs);
+			occluderTriangleTotal += occlusionBuffer.rasterizedTriangles();
+
+			std::atomic<size_t> hidden(0);
+			jobs.parallelFor(visibleRanges.size(), 1, [&hidden](size_t first, size_t end)
+			{
+				for (size_t range = first; range < end; range++)
+				{
+					std::vector<unsigned int>& visible = visibleRanges[range];
+					const size_t before = visible.size();
+					visible.erase(std::remove_if(visible.begin(), visible.end(), [](unsigned int i)
+					{
+						const glm::vec3 center(objectBounds.centerX[i], objectBounds.centerY[i], objectBounds.centerZ[i]);
+						const glm::vec3 extent(objectBounds.extentX[i], objectBounds.extentY[i], objectBounds.extentZ[i]);
+						return !occlusionBuffer.visible(center, extent);
+					}), visible.end());
+					hidden += before - visible.size();
+				}
+			});
+			occludedTotal += hidden;
+			occlusionSeconds += Utility::getTime() - start;
+		}, { cull, objectTransformTask });
+	}
+
+	//Commands are built on the CPU here, drawObjectScene() uploads them on the GL thread
+	objectCommandsTask = jobs.add([]()
+	{
+		visibleObjects.clear();
+		for (const std::vector<unsigned int>& visible : visibleRanges)
+			visibleObjects.insert(visibleObjects.end(), visible.begin(), visible.end());
+		culledFrames++;
+		visibleTotal += visibleObjects.size();
+		if (lodSelection)
+			selectObjectLods();
+
+		if (directDraws)
+			return;
+		objectDraws.clear();
+		for (unsigned int index : visibleObjects)
+			objectDraws.add(objects[index].bucket, objectMesh(index), objectHierarchy ? objectNodes[index] : index);
+	}, { cull });
+}
+
+void drawObjectScene()
+{
+	if (!gpuCulling)
+	{
+		jobs.wait(objectCommandsTask);
+		if (!directDraws)
+			objectDraws.upload();
+	}
+	if (objectTransformTask != NULL)
+		jobs.wait(objectTransformTask);
+	if (objectGraphTask != NULL)
+		jobs.wait(objectGraphTask); // the CPU commands waited through the cull task, --gpu-cull has none
+	if (objectHierarchy && !directDraws)
+	{
+		//Only what moved goes to the GPU
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectModelBuffer);
+		for (const SceneGraph::Range& range : objectGraph.changedRanges())
+			UploadCounter::bufferSubData(GL_SHADER_STORAGE_BUFFER, range.first * sizeof(glm::mat4), (range.second - range.first) * sizeof(glm::mat4), objectGraph.worldData() + range.first);
+	}
+
+	//The draws still hold last frame's solid survivors, drawn with this frame's camera and models they are the occluders
+	if (occlusionCulling)
+	{
+		depthPyramid.beginDepth();
+		gpuCulledShaders[SOLID_OBJECTS]->use();
+		gpuCull.draw(SOLID_OBJECTS);
+		depthPyramid.endDepth();
+	}
+	//After the models are in place, the draws below read what the pass writes
+	if (gpuCulling)
+	{
+		gpuCull.cull(cameraFrustum, occlusionCulling ? &depthPyramid : nullptr);
+		objectPassTimer.begin();
+	}
+
+	const GLenum polygonModes[2] = { GL_FILL, GL_LINE };
+	for (unsigned int bucket = SOLID_OBJECTS; bucket <= WIRE_OBJECTS; bucket++)
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, polygonModes[bucket]);
+		if (gpuCulling)
+		{
+			gpuCulledShaders[bucket]->use();
+			gpuCull.draw(bucket);
+			continue;
+		}
+		if (!directDraws)
+		{
+			multidrawShaders[bucket]->use();
+			objectDraws.draw(bucket);
+			continue;
+		}
+		//Baseline, a uniform update and a draw call per object
+		Shader* variant = shaderVariants.find(bucket == WIRE_OBJECTS ? "line" : "fill");
+		const Uniform<glm::mat4> model = variant->uniform<glm::mat4>("model");
+		variant->use();
+		for (unsigned int index : visibleObjects)
+		{
+			const Object& object = objects[index];
+			if (object.bucket != bucket)
+				continue;
+			variant->set(model, objectHierarchy ? objectGraph.world(objectNodes[index]) : objectModels[index]);
+			meshBuffer.draw(objectMesh(index));
+		}
+	}
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	if (gpuCulling)
+		objectPassTimer.end();
+	if (animateObjects && !directDraws)
+		objectStream.endFrame();
+}
+
+void selectObjectLods()
+{
+	//A level's error in pixels is its error in object units over the view depth of the object's nearest point,
+	//the models are rigid so object units are world units
+	for (unsigned int index : visibleObjects)
+	{
+		const Shape& shape = *objects[index].shape;
+		const glm::vec4 center(objectBounds.centerX[index], objectBounds.centerY[index], objectBounds.centerZ[index], 1.0f);
+		const float depth = (cameraViewProjection * center).w - objectBounds.radius[index];
+		objectLevels[index] = static_cast<unsigned char>(depth > 0.0f ? shape.lod.select(cameraPixelsPerUnit / depth, LOD_PIXEL_ERROR) : 0);
+		lodTriangleTotal += shape.lodMeshes[objectLevels[index]].indexCount / 3;
+		fullTriangleTotal += shape.mesh.indexCount / 3;
+	}
+}
+
+const MeshBuffer::Mesh& objectMesh(unsigned int object)
+{
+	//This frame's level with --lod, after selectObjectLods()
+	const Shape& shape = *objects[object].shape;
+	return lodSelection ? shape.lodMeshes[objectLevels[object]] : shape.mesh;
+}
+
+void printOcclusionStats()
+{
+	//Counted on the GPU since the last call, reading them waits for it
+	const GpuCulling::Stats stats = gpuCull.takeStats();
+	if (stats.culls == 0)
+		return;
+	const double outside = static_cast<double>(stats.outsideFrustum) / stats.culls;
+	const double occluded = static_cast<double>(stats.occluded) / stats.culls;
+	const double drawn = objectCount - outside - occluded;
+	std::cout << "GPU culled objects per frame: " << 100.0 * outside / objectCount << "% outside the frustum, "
+		<< 100.0 * occluded / objectCount << "% occluded, " << drawn << " drawn; object draws " << objectPassTimer.averageMs() << " ms on the GPU" << std::endl;
+	if (!occlusionCulling)
+		return;
+	//The pass cost is measured; what the occluded objects would have cost is only estimated from the
+	//average per drawn object, so both are printed and the pass is only called a saving when it is one
+	const double prepassMs = depthPyramid.averageMs();
+	const double occludedMs = drawn > 0.0 ? objectPassTimer.averageMs() / drawn * occluded : 0.0;
+	std::cout << "Occlusion culling: " << depthPyramid.width << "x" << depthPyramid.height << " pyramid of " << depthPyramid.levels << " levels, prepass and pyramid "
+		<< prepassMs << " ms, " << occluded << " objects occluded per frame, which would have taken about " << occludedMs << " ms to draw (estimate, "
+		<< (occludedMs > prepassMs ? "the pass saves time" : "the pass costs more than it saves") << ")" << std::endl;
+}
+
+glm::mat4 objectModel(unsigned int object)
+{
+	//Wherever this mode keeps the current model on the CPU
+	if (objectHierarchy)
+		return objectGraph.world(objectNodes[object]);
+	if (animateObjects && !directDraws)
+		return objectTransforms.computeOne(object);
+	return objectModels[object];
+}
+
+void pickObject(double x, double y)
+{
+	//Moving objects are refit at most once per frame, and only when something is picked
+	if ((animateObjects || objectHierarchy) && pickSceneFrame != frameCount)
+	{
+		pickSceneFrame = frameCount;
+		for (unsigned int i = 0; i < objectCount; i++)
+			pickScene.setModel(i, objectModel(i));
+		pickScene.refit();
+	}
+
+	//Cursor (0..1 from the top left) from the near to the far plane of the last frame's camera
+	const glm::mat4 inverse = glm::inverse(cameraViewProjection);
+	const glm::vec2 ndc(static_cast<float>(x) * 2.0f - 1.0f, 1.0f - static_cast<float>(y) * 2.0f);
+	const glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+	const glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+
+	RayHit hit;
+	if (pickScene.intersect(ray, hit))
+		std::cout << "Picked object " << hit.instance << " (" << objects[hit.instance].shape->name << "), triangle " << hit.triangle << ", " << hit.t << " units away" << std::endl;
+	else
+		std::cout << "Picked nothing" << std::endl;
+}
+
+void chooseOccluders(const std::vector<unsigned int>& candidates, const CullingBounds& bounds, const glm::mat4& viewProjection, std::vector<unsigned int>& occluders)
+{
+	//Size on screen as bounding radius over view depth, the largest first since they hide the most
+	std::vector<std::pair<float, unsigned int>> sized;
+	for (unsigned int i : candidates)
+	{
+		const float w = (viewProjection * glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], 1.0f)).w;
+		if (w <= bounds.radius[i])
+			continue; // around the camera, most of its triangles would cross the camera plane
+		const float size = bounds.radius[i] / w;
+		if (size >= MIN_OCCLUDER_SIZE)
+			sized.push_back(std::make_pair(size, i));
+	}
+	std::sort(sized.begin(), sized.end(), std::greater<std::pair<float, unsigned int>>());
+	occluders.clear();
+	for (size_t i = 0; i < sized.size() && i < MAX_OCCLUDERS; i++)
+		occluders.push_back(sized[i].second);
+}
+
+void localBounds(const Shape& shape, glm::vec3& low, glm::vec3& high)
+{
+	low = glm::vec3(FLT_MAX);
+	high = glm::vec3(-FLT_MAX);
+	for (const glm::vec3& vertex : shape.view.vertices)
+	{
+		low = glm::min(low, vertex);
+		high = glm::max(high, vertex);
+	}
+}
+
+void drawBounds(const Shape& shape, const glm::mat4& model)
+{
+	//Local bounds
+	glm::vec3 low, high;
+	localBounds(shape, low, high);
+
+	//12 edges in world space, written straight into the mapped buffer
+	static const int edges[12][2] = {
+		{0, 1}, {1, 3}, {3, 2}, {2, 0},
+		{4, 5}, {5, 7}, {7, 6}, {6, 4},
+		{0, 4}, {1, 5}, {2, 6}, {3, 7}
+	};
+	size_t offset = 0;
+	glm::vec3* lines = debugStream.allocate<glm::vec3>(24, offset);
+	if (lines == NULL)
+		return;
+	for (int edge = 0; edge < 12; edge++)
+	{
+		for (int end = 0; end < 2; end++)
+		{
+			const int corner = edges[edge][end];
+			const glm::vec3 point(corner & 1 ? high.x : low.x, corner & 2 ? high.y : low.y, corner & 4 ? high.z : low.z);
+			lines[edge * 2 + end] = glm::vec3(model * glm::vec4(point, 1.0f));
+		}
+	}
+
+	Shader* lineShader = shaderVariants.find("line");
+	lineShader->use();
+	lineShader->setMat4("model", glm::mat4(1.0f));
+	glBindVertexArray(debugVAO);
+	glDrawArrays(GL_LINES, static_cast<GLint>(offset / sizeof(glm::vec3)), 24);
+	meshBuffer.bind();
+	shader->use();
 }
 /*
 void setTransform(Shader shader)
@@ -503,17 +1812,3 @@ void setTransform(Shader shader)
 	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
 	shader.setMat4("projection", projection);
 }*/
-
-void bind(Shape shape)
-{
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, shape.vertexCount * sizeof(glm::vec3), shape.vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, shape.indicesSize, shape.indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-	glEnableVertexAttribArray(0);
-	glBindVertexArray(VAO);
-
-}
\ No newline at end of file
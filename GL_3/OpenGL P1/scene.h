@@ -0,0 +1,49 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm/glm.hpp>
+#include <helpers/meshbuffer.h>
+#include <helpers/meshview.h>
+#include <helpers/meshlod.h>
+#include <helpers/culling.h>
+#include <helpers/jobsystem.h>
+
+#include <string>
+#include <vector>
+
+// What main.cpp shares with benchmarks.cpp: the shapes, the object scene's layout and camera,
+// and the settings both sides have to agree on. Defined in main.cpp.
+
+struct Shape {
+	std::string name;
+	MeshView view; // element counts taken from the arrays
+	MeshBuffer::Mesh mesh; // set when uploaded to meshBuffer
+	MeshLod lod; // --lod, levels of detail, levels[0] is view
+	std::vector<MeshBuffer::Mesh> lodMeshes; // every level in meshBuffer, lodMeshes[0] is mesh
+
+	Shape(const std::string& name, const MeshView& view) : name(name), view(view) {}
+};
+
+// settings
+extern int SCREEN_WIDTH;
+extern int SCREEN_HEIGHT;
+static const size_t CULL_RANGE = 4096; // objects per culling job
+static const int OCCLUSION_WIDTH = 320; // pixels of occlusionBuffer, a fifth of the screen's
+static const float LOD_PIXEL_ERROR = 1.0f; // how far a level may move the surface on screen
+static const float LOD_MAX_ERROR = 0.25f; // of a shape's bounding radius, where its chain ends
+
+// shapes
+extern Shape shapes[];
+extern const unsigned int shapeCount;
+extern unsigned int objectShapeCount; // the object scene's shapes, the sphere only joins with --lod
+
+// object scene
+extern JobSystem jobs; // per-frame CPU work, tasks end with the frame
+extern float cameraDistance;
+extern float farPlane;
+
+std::vector<glm::mat4> gridTransforms(unsigned int count); // also moves the camera back until the block fits
+void localBounds(const Shape& shape, glm::vec3& low, glm::vec3& high);
+MeshView generateSphere(unsigned int subdivisions, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices);
+void chooseOccluders(const std::vector<unsigned int>& candidates, const CullingBounds& bounds, const glm::mat4& viewProjection, std::vector<unsigned int>& occluders);
+#endif
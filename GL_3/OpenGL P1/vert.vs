@@ -1,16 +1,48 @@
 #version 400 core
+#if defined(MULTIDRAW) || defined(GPU_CULLED)
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 layout (location = 0) in vec3 pos;
-// Properties
+#include "camera.glsl"
+#if defined(MULTIDRAW)
+// Per draw (DrawCommands) the object index, gl_DrawIDARB is the index of the draw inside its
+// multi-draw call. The models of all objects stay in ObjectData, so culled draws cost nothing.
+layout (std430, binding = 0) readonly buffer DrawData
+{
+	uint draws[];
+};
+layout (std430, binding = 1) readonly buffer ObjectData
+{
+	mat4 objectModels[];
+};
+#define model objectModels[draws[gl_DrawIDARB]]
+#elif defined(GPU_CULLED)
+// One draw per mesh (GpuCulling), its instances are the objects cull.comp let through:
+// their indices start at the draw's baseInstance. Same ObjectData as MULTIDRAW.
+layout (std430, binding = 0) readonly buffer DrawData
+{
+	uint visibleInstances[];
+};
+layout (std430, binding = 1) readonly buffer ObjectData
+{
+	mat4 objectModels[];
+};
+#define model objectModels[visibleInstances[gl_BaseInstanceARB + gl_InstanceID]]
+#elif defined(INSTANCED)
+// Per instance (InstanceBuffer)
+layout (location = 1) in mat4 model;
+#else
+// Per object
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(pos, 1.0);
+	gl_Position = viewProjection * model * vec4(pos, 1.0);
 }
 
-// Instead of passing model, view, and projection each after one, 
-// just pass all or multiply in one combined matrix.
-// Result = less uniforms
-// Example: Make a Transform variable, which has everything in it
\ No newline at end of file
+// View and projection only change once per frame, so they live in the Camera
+// uniform buffer and are already combined on the CPU (viewProjection).
+// Only the model matrix is sent per draw, read per instance when INSTANCED
+// or per draw of a multi-draw call when MULTIDRAW, or per culled instance when GPU_CULLED.
@@ -1,7 +1,8 @@
 #pragma once
+#include <cmath>
 #include <string>
 
-static class Utility
+class Utility
 {
 
 public:
@@ -22,5 +23,10 @@ public:
 	/// </summary>
 	/// <param name="hex">Hex style = 0xFFFFFF</param>
 	static void hexTo_RGB(const int hex, float& r, float& g, float& b);
+
+	/// <summary>
+	/// Returns seconds since the first call (monotonic, works without a window)
+	/// </summary>
+	static double getTime();
 };
 
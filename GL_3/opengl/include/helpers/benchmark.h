@@ -0,0 +1,140 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// Per-frame CPU and GPU timings of a fixed-length run.
+// GPU time comes from a pair of GL_TIMESTAMP queries per frame, read back a few
+// frames late (QUERY_LATENCY) so that collecting them never stalls the pipeline.
+class Benchmark
+{
+public:
+	struct Frame
+	{
+		double cpuMs = 0.0; // submission time on the CPU (begin to end of frame)
+		double gpuMs = 0.0; // time the GPU spent on the frame's commands
+		unsigned long long uploadBytes = 0; // UploadCounter
+	};
+	std::vector<Frame> frames;
+
+	// ------------------------------------------------------------------------
+	void create(unsigned int frameCount)
+	{
+		frames.clear();
+		frames.reserve(frameCount);
+		glGenQueries(QUERY_LATENCY * 2, queries);
+		current = 0;
+	}
+	// ------------------------------------------------------------------------
+	void beginFrame()
+	{
+		const unsigned int slot = current % QUERY_LATENCY;
+		if (current >= QUERY_LATENCY)
+			collect(current - QUERY_LATENCY);
+		frames.push_back(Frame());
+		glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+		cpuStart = std::chrono::steady_clock::now();
+	}
+	// ------------------------------------------------------------------------
+	void endFrame(unsigned long long uploadBytes = 0)
+	{
+		glQueryCounter(queries[(current % QUERY_LATENCY) * 2 + 1], GL_TIMESTAMP);
+		frames[current].uploadBytes = uploadBytes;
+		frames[current].cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+		current++;
+	}
+	// waits for the outstanding queries
+	// ------------------------------------------------------------------------
+	void finish()
+	{
+		glFinish();
+		const unsigned int first = current > QUERY_LATENCY ? current - QUERY_LATENCY : 0;
+		for (unsigned int i = first; i < current; i++)
+			collect(i);
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteQueries(QUERY_LATENCY * 2, queries);
+	}
+	// writes JSON if the path ends in ".json", CSV otherwise
+	// ------------------------------------------------------------------------
+	bool write(const std::string& path, const std::string& renderer) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITABLE " << path << std::endl;
+			return false;
+		}
+		const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+		if (json)
+		{
+			file << "{\n\t\"renderer\": \"" << escape(renderer) << "\",\n\t\"frames\": [\n";
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				file << "\t\t{ \"frame\": " << i << ", \"cpu_ms\": " << frames[i].cpuMs << ", \"gpu_ms\": " << frames[i].gpuMs << ", \"upload_bytes\": " << frames[i].uploadBytes << " }"
+					<< (i + 1 < frames.size() ? ",\n" : "\n");
+			}
+			file << "\t]\n}\n";
+		}
+		else
+		{
+			file << "frame,cpu_ms,gpu_ms,upload_bytes\n";
+			for (size_t i = 0; i < frames.size(); i++)
+				file << i << "," << frames[i].cpuMs << "," << frames[i].gpuMs << "," << frames[i].uploadBytes << "\n";
+		}
+		return true;
+	}
+	// ------------------------------------------------------------------------
+	void printSummary() const
+	{
+		if (frames.empty())
+			return;
+		double cpuTotal = 0.0, gpuTotal = 0.0, cpuMax = 0.0, gpuMax = 0.0;
+		for (const Frame& frame : frames)
+		{
+			cpuTotal += frame.cpuMs;
+			gpuTotal += frame.gpuMs;
+			cpuMax = std::max(cpuMax, frame.cpuMs);
+			gpuMax = std::max(gpuMax, frame.gpuMs);
+		}
+		const double count = static_cast<double>(frames.size());
+		std::cout << "Benchmark: " << frames.size() << " frames" << std::endl;
+		std::cout << "  CPU avg " << cpuTotal / count << " ms, max " << cpuMax << " ms" << std::endl;
+		std::cout << "  GPU avg " << gpuTotal / count << " ms, max " << gpuMax << " ms" << std::endl;
+	}
+
+private:
+	static const unsigned int QUERY_LATENCY = 4;
+	unsigned int queries[QUERY_LATENCY * 2] = {}; // begin/end timestamp pairs
+	unsigned int current = 0;
+	std::chrono::steady_clock::time_point cpuStart;
+
+	void collect(unsigned int frame)
+	{
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(queries[(frame % QUERY_LATENCY) * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries[(frame % QUERY_LATENCY) * 2 + 1], GL_QUERY_RESULT, &end);
+		frames[frame].gpuMs = end > begin ? (end - begin) / 1000000.0 : 0.0;
+	}
+	static std::string escape(const std::string& text)
+	{
+		std::string result;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result;
+	}
+};
+#endif
@@ -0,0 +1,482 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/simd/platform.h> // GLM_ARCH and the intrinsics header it implies
+#include <helpers/jobsystem.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// axis aligned box, empty until something is grown into it
+// ------------------------------------------------------------------------
+struct BvhBox
+{
+	glm::vec3 low = glm::vec3(FLT_MAX);
+	glm::vec3 high = glm::vec3(-FLT_MAX);
+
+	void grow(const glm::vec3& point)
+	{
+		low = glm::min(low, point);
+		high = glm::max(high, point);
+	}
+	void grow(const BvhBox& box)
+	{
+		low = glm::min(low, box.low);
+		high = glm::max(high, box.high);
+	}
+	glm::vec3 center() const
+	{
+		return (low + high) * 0.5f;
+	}
+	float area() const
+	{
+		const glm::vec3 size = glm::max(high - low, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+};
+
+// origin + t * direction for t in [0, tMax)
+// ------------------------------------------------------------------------
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMax = FLT_MAX;
+};
+
+// Bounding volume hierarchy over any primitives that have a box (triangles, object bounds).
+// build() splits with the surface area heuristic over BINS buckets per axis, large subtrees
+// are built in parallel when a JobSystem is given. The binary tree is then collapsed into
+// nodes of 4 children, stored as structure of arrays so traversal tests a ray against all 4
+// boxes with one SSE slab test. refit() updates the boxes after the primitives moved, without
+// changing the tree (fine while they move coherently, rebuild when the tree degrades).
+class Bvh
+{
+public:
+	static const unsigned int BINS = 16;
+	static const unsigned int MAX_LEAF_SIZE = 8;
+	static const unsigned int PARALLEL_SIZE = 4096; // subtrees larger than this are split across jobs
+
+	// ------------------------------------------------------------------------
+	static const char* path()
+	{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		return "SSE2, 4 boxes per node";
+#else
+		return "scalar";
+#endif
+	}
+	// ------------------------------------------------------------------------
+	void build(const std::vector<BvhBox>& boxes, JobSystem* jobs = nullptr)
+	{
+		nodes.clear();
+		levels = 0;
+		order.resize(boxes.size());
+		for (unsigned int i = 0; i < order.size(); i++)
+			order[i] = i;
+		if (boxes.empty())
+			return;
+
+		std::vector<glm::vec3> centers(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++)
+			centers[i] = boxes[i].center();
+		BuildState state{ boxes, centers, std::vector<BuildNode>(boxes.size() * 2), 1, jobs };
+		state.nodes[0].first = 0;
+		state.nodes[0].count = static_cast<unsigned int>(boxes.size());
+		split(state, 0);
+
+		buildNodes = std::move(state.nodes);
+		collapse(0, 1);
+		buildNodes.clear();
+		buildNodes.shrink_to_fit();
+	}
+	// boxes in the same order as at build(), bottom up (children come after their parents)
+	// ------------------------------------------------------------------------
+	void refit(const std::vector<BvhBox>& boxes)
+	{
+		for (size_t n = nodes.size(); n-- > 0;)
+		{
+			Node& node = nodes[n];
+			for (int k = 0; k < 4; k++)
+			{
+				BvhBox box;
+				if (node.count[k] > 0)
+				{
+					for (unsigned int i = node.child[k]; i < node.child[k] + node.count[k]; i++)
+						box.grow(boxes[order[i]]);
+				}
+				else if (node.child[k] != EMPTY)
+				{
+					box = nodes[node.child[k]].bounds();
+				}
+				else
+				{
+					continue;
+				}
+				node.set(k, box);
+			}
+		}
+	}
+	// leaf(primitive, ray) tests one primitive and shortens ray.tMax on a hit,
+	// children are visited nearest first so far ones are skipped once something is hit
+	// ------------------------------------------------------------------------
+	template<typename Leaf>
+	void intersect(Ray& ray, Leaf&& leaf) const
+	{
+		if (nodes.empty())
+			return;
+		const glm::vec3 inverse = inverseDirection(ray.direction);
+		unsigned int local[STACK_SIZE];
+		std::vector<unsigned int> heap;
+		unsigned int* stack = traversalStack(local, heap);
+		unsigned int depth = 0;
+		stack[depth++] = 0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		const __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+		const __m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+#endif
+		while (depth > 0)
+		{
+			const Node& node = nodes[stack[--depth]];
+			float entry[4];
+			int mask = 0;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lowX), ox), ix);
+			const __m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.highX), ox), ix);
+			const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lowY), oy), iy);
+			const __m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.highY), oy), iy);
+			const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lowZ), oz), iz);
+			const __m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.highZ), oz), iz);
+			const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_max_ps(_mm_min_ps(z1, z2), _mm_setzero_ps()));
+			const __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_min_ps(_mm_max_ps(z1, z2), _mm_set1_ps(ray.tMax)));
+			mask = _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+			_mm_storeu_ps(entry, enter);
+#else
+			mask = slabs(node, ray, inverse, entry);
+#endif
+			visit(node, mask, entry, stack, depth, ray, leaf);
+		}
+	}
+	// same traversal testing one box at a time, the reference for the SIMD kernel
+	// ------------------------------------------------------------------------
+	template<typename Leaf>
+	void intersectScalar(Ray& ray, Leaf&& leaf) const
+	{
+		if (nodes.empty())
+			return;
+		const glm::vec3 inverse = inverseDirection(ray.direction);
+		unsigned int local[STACK_SIZE];
+		std::vector<unsigned int> heap;
+		unsigned int* stack = traversalStack(local, heap);
+		unsigned int depth = 0;
+		stack[depth++] = 0;
+		while (depth > 0)
+		{
+			const Node& node = nodes[stack[--depth]];
+			float entry[4];
+			const int mask = slabs(node, ray, inverse, entry);
+			visit(node, mask, entry, stack, depth, ray, leaf);
+		}
+	}
+	// ------------------------------------------------------------------------
+	size_t nodeCount() const
+	{
+		return nodes.size();
+	}
+	// levels of 4-wide nodes from the root down to the deepest leaf
+	unsigned int levelCount() const
+	{
+		return levels;
+	}
+	BvhBox bounds() const
+	{
+		return nodes.empty() ? BvhBox() : nodes[0].bounds();
+	}
+
+private:
+	static const unsigned int EMPTY = 0xFFFFFFFFu;
+	static const unsigned int STACK_SIZE = 256; // on the stack, deeper trees get a heap stack
+
+	// 4 children, leaves hold count primitives from order[child]
+	struct alignas(16) Node
+	{
+		float lowX[4], lowY[4], lowZ[4];
+		float highX[4], highY[4], highZ[4];
+		unsigned int child[4];
+		unsigned int count[4];
+
+		Node()
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				set(k, BvhBox());
+				child[k] = EMPTY;
+				count[k] = 0;
+			}
+		}
+		void set(int k, const BvhBox& box)
+		{
+			lowX[k] = box.low.x;
+			lowY[k] = box.low.y;
+			lowZ[k] = box.low.z;
+			highX[k] = box.high.x;
+			highY[k] = box.high.y;
+			highZ[k] = box.high.z;
+		}
+		BvhBox bounds() const
+		{
+			BvhBox box;
+			for (int k = 0; k < 4; k++)
+			{
+				if (child[k] == EMPTY)
+					continue;
+				box.grow(glm::vec3(lowX[k], lowY[k], lowZ[k]));
+				box.grow(glm::vec3(highX[k], highY[k], highZ[k]));
+			}
+			return box;
+		}
+	};
+	struct BuildNode
+	{
+		BvhBox box;
+		unsigned int first = 0, count = 0; // primitives in order
+		unsigned int left = EMPTY; // right = left + 1, EMPTY for leaves
+	};
+	struct BuildState
+	{
+		const std::vector<BvhBox>& boxes;
+		const std::vector<glm::vec3>& centers;
+		std::vector<BuildNode> nodes;
+		std::atomic<unsigned int> used;
+		JobSystem* jobs;
+	};
+	std::vector<Node> nodes; // [0] is the root
+	std::vector<unsigned int> order; // primitive indices, leaves are ranges of it
+	std::vector<BuildNode> buildNodes;
+	unsigned int levels = 0;
+
+	// ------------------------------------------------------------------------
+	void split(BuildState& state, unsigned int index)
+	{
+		BuildNode& node = state.nodes[index];
+		BvhBox centerBox;
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			node.box.grow(state.boxes[order[i]]);
+			centerBox.grow(state.centers[order[i]]);
+		}
+		if (node.count <= 2)
+			return;
+
+		//Bins along every axis, the plane with the lowest area * count on both sides wins
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		unsigned int bestPlane = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float low = centerBox.low[axis], extent = centerBox.high[axis] - low;
+			if (extent <= 0.0f)
+				continue;
+			BvhBox binBoxes[BINS];
+			unsigned int binCounts[BINS] = {};
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				const unsigned int bin = binOf(state.centers[order[i]][axis], low, extent);
+				binCounts[bin]++;
+				binBoxes[bin].grow(state.boxes[order[i]]);
+			}
+			float rightAreas[BINS];
+			unsigned int rightCounts[BINS];
+			BvhBox right;
+			unsigned int rightCount = 0;
+			for (unsigned int bin = BINS - 1; bin > 0; bin--)
+			{
+				right.grow(binBoxes[bin]);
+				rightCount += binCounts[bin];
+				rightAreas[bin] = right.area();
+				rightCounts[bin] = rightCount;
+			}
+			BvhBox left;
+			unsigned int leftCount = 0;
+			for (unsigned int plane = 1; plane < BINS; plane++)
+			{
+				left.grow(binBoxes[plane - 1]);
+				leftCount += binCounts[plane - 1];
+				if (leftCount == 0 || rightCounts[plane] == 0)
+					continue;
+				const float cost = left.area() * leftCount + rightAreas[plane] * rightCounts[plane];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestPlane = plane;
+				}
+			}
+		}
+
+		//Stay a leaf when splitting costs more than testing everything
+		const float leafCost = node.box.area() * node.count;
+		unsigned int middle = node.first;
+		if (bestAxis >= 0)
+		{
+			if (node.count <= MAX_LEAF_SIZE && bestCost >= leafCost)
+				return;
+			const float low = centerBox.low[bestAxis], extent = centerBox.high[bestAxis] - low;
+			middle = static_cast<unsigned int>(std::partition(order.begin() + node.first, order.begin() + node.first + node.count,
+				[&](unsigned int primitive) { return binOf(state.centers[primitive][bestAxis], low, extent) < bestPlane; }) - order.begin());
+		}
+		else if (node.count <= MAX_LEAF_SIZE)
+		{
+			return;
+		}
+		else
+		{
+			middle = node.first + node.count / 2; // every center in one spot, any split will do
+		}
+
+		const unsigned int left = state.used.fetch_add(2);
+		state.nodes[left].first = node.first;
+		state.nodes[left].count = middle - node.first;
+		state.nodes[left + 1].first = middle;
+		state.nodes[left + 1].count = node.first + node.count - middle;
+		node.left = left;
+		if (state.jobs != nullptr && node.count > PARALLEL_SIZE)
+		{
+			state.jobs->parallelFor(2, 1, [&](size_t first, size_t end)
+			{
+				for (size_t child = first; child < end; child++)
+					split(state, left + static_cast<unsigned int>(child));
+			});
+		}
+		else
+		{
+			split(state, left);
+			split(state, left + 1);
+		}
+	}
+	static unsigned int binOf(float center, float low, float extent)
+	{
+		const unsigned int bin = static_cast<unsigned int>((center - low) / extent * BINS);
+		return std::min(bin, BINS - 1);
+	}
+	// 4-wide node for binary node index, pulls the largest grandchildren up until 4 children
+	// ------------------------------------------------------------------------
+	unsigned int collapse(unsigned int index, unsigned int level)
+	{
+		levels = std::max(levels, level);
+		unsigned int children[4];
+		unsigned int childCount = 0;
+		if (buildNodes[index].left == EMPTY)
+		{
+			children[childCount++] = index; // the whole tree is one leaf
+		}
+		else
+		{
+			children[childCount++] = buildNodes[index].left;
+			children[childCount++] = buildNodes[index].left + 1;
+		}
+		while (childCount < 4)
+		{
+			int largest = -1;
+			for (unsigned int k = 0; k < childCount; k++)
+			{
+				if (buildNodes[children[k]].left != EMPTY && (largest < 0 || buildNodes[children[k]].box.area() > buildNodes[children[largest]].box.area()))
+					largest = static_cast<int>(k);
+			}
+			if (largest < 0)
+				break;
+			const unsigned int opened = children[largest];
+			children[largest] = buildNodes[opened].left;
+			children[childCount++] = buildNodes[opened].left + 1;
+		}
+
+		const unsigned int nodeIndex = static_cast<unsigned int>(nodes.size());
+		nodes.emplace_back();
+		for (unsigned int k = 0; k < childCount; k++)
+		{
+			const BuildNode& child = buildNodes[children[k]];
+			nodes[nodeIndex].set(k, child.box);
+			if (child.left == EMPTY)
+			{
+				nodes[nodeIndex].child[k] = child.first;
+				nodes[nodeIndex].count[k] = child.count;
+			}
+			else
+			{
+				const unsigned int childIndex = collapse(children[k], level + 1); // may move nodes, index again below
+				nodes[nodeIndex].child[k] = childIndex;
+			}
+		}
+		return nodeIndex;
+	}
+	// ------------------------------------------------------------------------
+	static glm::vec3 inverseDirection(const glm::vec3& direction)
+	{
+		glm::vec3 inverse;
+		for (int axis = 0; axis < 3; axis++)
+			inverse[axis] = 1.0f / (std::fabs(direction[axis]) > 1e-20f ? direction[axis] : 1e-20f);
+		return inverse;
+	}
+	static int slabs(const Node& node, const Ray& ray, const glm::vec3& inverse, float entry[4])
+	{
+		int mask = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			const glm::vec3 t1 = (glm::vec3(node.lowX[k], node.lowY[k], node.lowZ[k]) - ray.origin) * inverse;
+			const glm::vec3 t2 = (glm::vec3(node.highX[k], node.highY[k], node.highZ[k]) - ray.origin) * inverse;
+			const glm::vec3 enter = glm::min(t1, t2), leave = glm::max(t1, t2);
+			entry[k] = std::max(std::max(enter.x, enter.y), std::max(enter.z, 0.0f));
+			const float exit = std::min(std::min(leave.x, leave.y), std::min(leave.z, ray.tMax));
+			mask |= entry[k] <= exit ? 1 << k : 0;
+		}
+		return mask;
+	}
+	// Traversal pops one node and pushes at most 4, so every level leaves at most 3 siblings
+	// waiting: 3 * levels + 1 entries are always enough and no node is ever dropped
+	unsigned int* traversalStack(unsigned int* local, std::vector<unsigned int>& heap) const
+	{
+		const size_t needed = 3 * static_cast<size_t>(levels) + 1;
+		if (needed <= STACK_SIZE)
+			return local;
+		heap.resize(needed);
+		return heap.data();
+	}
+	// leaves right away, inner nodes onto the stack farthest first
+	template<typename Leaf>
+	void visit(const Node& node, int mask, const float entry[4], unsigned int* stack, unsigned int& depth, Ray& ray, Leaf& leaf) const
+	{
+		unsigned int inner[4];
+		unsigned int innerCount = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			if (!(mask & (1 << k)) || node.child[k] == EMPTY)
+				continue;
+			if (node.count[k] == 0)
+			{
+				inner[innerCount++] = k;
+				continue;
+			}
+			for (unsigned int i = node.child[k]; i < node.child[k] + node.count[k]; i++)
+				leaf(order[i], ray);
+		}
+		//Insertion sort, at most four children
+		for (unsigned int i = 1; i < innerCount; i++)
+		{
+			const unsigned int k = inner[i];
+			unsigned int j = i;
+			for (; j > 0 && entry[inner[j - 1]] < entry[k]; j--)
+				inner[j] = inner[j - 1];
+			inner[j] = k;
+		}
+		for (unsigned int i = 0; i < innerCount; i++)
+		{
+			if (entry[inner[i]] <= ray.tMax)
+				stack[depth++] = node.child[inner[i]];
+		}
+	}
+};
+#endif
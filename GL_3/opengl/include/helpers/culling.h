@@ -0,0 +1,283 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/simd/platform.h> // GLM_ARCH and the intrinsics header it implies
+
+#include <cmath>
+#include <vector>
+
+// view frustum as six planes (xyz = normal pointing inside, w = distance), normalized
+// ------------------------------------------------------------------------
+struct Frustum
+{
+	glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+	// Gribb/Hartmann: the planes are sums and differences of the rows of projection * view
+	static Frustum fromMatrix(const glm::mat4& viewProjection)
+	{
+		const glm::mat4 m = glm::transpose(viewProjection); // m[i] is row i
+		Frustum frustum;
+		frustum.planes[0] = m[3] + m[0];
+		frustum.planes[1] = m[3] - m[0];
+		frustum.planes[2] = m[3] + m[1];
+		frustum.planes[3] = m[3] - m[1];
+		frustum.planes[4] = m[3] + m[2];
+		frustum.planes[5] = m[3] - m[2];
+		for (glm::vec4& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+};
+
+// World space bounds of many objects, structure of arrays so that one SIMD load fetches the same
+// component of 4 (SSE) or 8 (AVX) objects. Boxes are center/extent, spheres center/radius.
+// ------------------------------------------------------------------------
+struct CullingBounds
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	void resize(size_t count)
+	{
+		for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+			component->resize(count);
+	}
+	size_t size() const
+	{
+		return centerX.size();
+	}
+	// local box (center/extent) moved into world space by model, stays a box around the rotated one
+	void set(size_t i, const glm::mat4& model, const glm::vec3& localCenter, const glm::vec3& localExtent)
+	{
+		const glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+		const glm::mat3 axes(model);
+		const glm::vec3 extent = glm::abs(axes[0]) * localExtent.x + glm::abs(axes[1]) * localExtent.y + glm::abs(axes[2]) * localExtent.z;
+		centerX[i] = center.x;
+		centerY[i] = center.y;
+		centerZ[i] = center.z;
+		extentX[i] = extent.x;
+		extentY[i] = extent.y;
+		extentZ[i] = extent.z;
+		radius[i] = glm::length(extent);
+	}
+};
+
+// Frustum tests over CullingBounds, writing the indices of the visible objects densely into visible.
+// The SIMD paths follow GLM_ARCH (compile with AVX2/AVX for 8 lanes, SSE2 gives 4), the scalar ones
+// are the reference. Indices are written without branches: every lane stores its index and the
+// write position only advances for visible lanes.
+class FrustumCulling
+{
+public:
+	// ------------------------------------------------------------------------
+	static const char* path()
+	{
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		return "AVX, 8 lanes";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		return "SSE2, 4 lanes";
+#else
+		return "scalar";
+#endif
+	}
+	// ------------------------------------------------------------------------
+	static size_t cullBoxes(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible)
+	{
+		return cull<true>(frustum, bounds, 0, bounds.size(), visible);
+	}
+	static size_t cullSpheres(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible)
+	{
+		return cull<false>(frustum, bounds, 0, bounds.size(), visible);
+	}
+	// only objects first to end, so separate threads can cull separate ranges into their own lists
+	// ------------------------------------------------------------------------
+	static size_t cullBoxes(const Frustum& frustum, const CullingBounds& bounds, size_t first, size_t end, std::vector<unsigned int>& visible)
+	{
+		return cull<true>(frustum, bounds, first, end, visible);
+	}
+	// ------------------------------------------------------------------------
+	static size_t cullBoxesScalar(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible)
+	{
+		visible.resize(bounds.size());
+		return resizeTo(visible, scalar<true>(frustum, bounds, 0, bounds.size(), visible.data()));
+	}
+	static size_t cullSpheresScalar(const Frustum& frustum, const CullingBounds& bounds, std::vector<unsigned int>& visible)
+	{
+		visible.resize(bounds.size());
+		return resizeTo(visible, scalar<false>(frustum, bounds, 0, bounds.size(), visible.data()));
+	}
+
+private:
+	static size_t resizeTo(std::vector<unsigned int>& visible, size_t count)
+	{
+		visible.resize(count);
+		return count;
+	}
+
+	// objects first to end, returns the number written to out
+	template<bool BOX>
+	static size_t scalar(const Frustum& frustum, const CullingBounds& bounds, size_t first, size_t end, unsigned int* out)
+	{
+		size_t count = 0;
+		for (size_t i = first; i < end; i++)
+		{
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+				const float reach = BOX
+					? std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] + std::fabs(plane.z) * bounds.extentZ[i]
+					: bounds.radius[i];
+				if (distance + reach < 0.0f)
+				{
+					inside = false;
+					break;
+				}
+			}
+			out[count] = static_cast<unsigned int>(i);
+			count += inside ? 1 : 0;
+		}
+		return count;
+	}
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+	static const size_t LANES = 8;
+
+	template<bool BOX>
+	static size_t cull(const Frustum& frustum, const CullingBounds& bounds, size_t first, size_t end, std::vector<unsigned int>& visible)
+	{
+		visible.resize(end - first + LANES);
+		unsigned int* out = visible.data();
+		size_t count = 0;
+
+		__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm256_set1_ps(plane.x);
+			ny[p] = _mm256_set1_ps(plane.y);
+			nz[p] = _mm256_set1_ps(plane.z);
+			nw[p] = _mm256_set1_ps(plane.w);
+			ax[p] = _mm256_set1_ps(std::fabs(plane.x));
+			ay[p] = _mm256_set1_ps(std::fabs(plane.y));
+			az[p] = _mm256_set1_ps(std::fabs(plane.z));
+		}
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t i = first;
+		for (; i + LANES <= end; i += LANES)
+		{
+			const __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+			const __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+			const __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+			__m256 ex, ey, ez, r;
+			if (BOX)
+			{
+				ex = _mm256_loadu_ps(&bounds.extentX[i]);
+				ey = _mm256_loadu_ps(&bounds.extentY[i]);
+				ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+			}
+			else
+			{
+				r = _mm256_loadu_ps(&bounds.radius[i]);
+			}
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+					_mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+				const __m256 reach = BOX
+					? _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez))
+					: r;
+				distance = _mm256_add_ps(distance, reach);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+			}
+			const int mask = _mm256_movemask_ps(inside);
+			for (size_t lane = 0; lane < LANES; lane++)
+			{
+				out[count] = static_cast<unsigned int>(i + lane);
+				count += (mask >> lane) & 1;
+			}
+		}
+		count += scalar<BOX>(frustum, bounds, i, end, out + count);
+		return resizeTo(visible, count);
+	}
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+	static const size_t LANES = 4;
+
+	static __m128 absolute(float value)
+	{
+		return _mm_set1_ps(std::fabs(value));
+	}
+
+	template<bool BOX>
+	static size_t cull(const Frustum& frustum, const CullingBounds& bounds, size_t first, size_t end, std::vector<unsigned int>& visible)
+	{
+		visible.resize(end - first + LANES);
+		unsigned int* out = visible.data();
+		size_t count = 0;
+
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			nx[p] = _mm_set1_ps(plane.x);
+			ny[p] = _mm_set1_ps(plane.y);
+			nz[p] = _mm_set1_ps(plane.z);
+			nw[p] = _mm_set1_ps(plane.w);
+			ax[p] = absolute(plane.x);
+			ay[p] = absolute(plane.y);
+			az[p] = absolute(plane.z);
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = first;
+		for (; i + LANES <= end; i += LANES)
+		{
+			const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			__m128 ex, ey, ez, r;
+			if (BOX)
+			{
+				ex = _mm_loadu_ps(&bounds.extentX[i]);
+				ey = _mm_loadu_ps(&bounds.extentY[i]);
+				ez = _mm_loadu_ps(&bounds.extentZ[i]);
+			}
+			else
+			{
+				r = _mm_loadu_ps(&bounds.radius[i]);
+			}
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+					_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+				const __m128 reach = BOX
+					? _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez))
+					: r;
+				distance = _mm_add_ps(distance, reach);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+			}
+			const int mask = _mm_movemask_ps(inside);
+			for (size_t lane = 0; lane < LANES; lane++)
+			{
+				out[count] = static_cast<unsigned int>(i + lane);
+				count += (mask >> lane) & 1;
+			}
+		}
+		count += scalar<BOX>(frustum, bounds, i, end, out + count);
+		return resizeTo(visible, count);
+	}
+#else
+	template<bool BOX>
+	static size_t cull(const Frustum& frustum, const CullingBounds& bounds, size_t first, size_t end, std::vector<unsigned int>& visible)
+	{
+		visible.resize(end - first);
+		return resizeTo(visible, scalar<BOX>(frustum, bounds, first, end, visible.data()));
+	}
+#endif
+};
+#endif
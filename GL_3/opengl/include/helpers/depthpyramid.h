@@ -0,0 +1,147 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include <glad/glad.h>
+#include <helpers/gputimer.h>
+#include <helpers/shader.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Hierarchical depth (Hi-Z) for occlusion culling. Occluders are drawn between beginDepth() and
+// endDepth() into a depth-only target of the screen's size, endDepth() then reduces it into a
+// mip chain (hiz.comp) in which every texel holds the farthest depth of the area it covers.
+// A box whose nearest depth is behind the farthest depth of the texels around it is hidden.
+// Level 0 is half the screen size rounded up, the levels below it have GL's mip sizes; the
+// reduction rounds outwards where sizes don't halve evenly, so every level stays conservative.
+class DepthPyramid
+{
+public:
+	unsigned int texture = 0; // R32F, levels mips
+	int width = 0; // of level 0
+	int height = 0;
+	int levels = 0;
+
+	// ------------------------------------------------------------------------
+	bool create(int screenWidth, int screenHeight, const char* computePath)
+	{
+		ShaderSources sources;
+		if (!Shader::readCompute(computePath, sources) || !program.rebuild(sources))
+		{
+			std::cout << "ERROR::DEPTH_PYRAMID::PROGRAM_NOT_BUILT " << computePath << std::endl;
+			return false;
+		}
+		sourceLevelUniform = program.uniform<int>("sourceLevel");
+		depthWidth = screenWidth;
+		depthHeight = screenHeight;
+
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, depthWidth, depthHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GLint previousFramebuffer = 0; // not always 0, headless runs draw into their own
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		if (!complete)
+		{
+			std::cout << "ERROR::DEPTH_PYRAMID::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+			return false;
+		}
+
+		width = std::max(1, (depthWidth + 1) / 2);
+		height = std::max(1, (depthHeight + 1) / 2);
+		levels = 1;
+		for (int size = std::max(width, height); size > 1; size /= 2)
+			levels++;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		timer.create();
+		return true;
+	}
+	// the occluders go into the pyramid's own depth target until endDepth()
+	// ------------------------------------------------------------------------
+	void beginDepth()
+	{
+		timer.begin();
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, savedViewport);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, depthWidth, depthHeight);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	// builds every level from the depth, restores the caller's framebuffer and viewport
+	// ------------------------------------------------------------------------
+	void endDepth()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+		glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+
+		program.use();
+		glActiveTexture(GL_TEXTURE0 + REDUCE_UNIT);
+		int levelWidth = width, levelHeight = height;
+		for (int level = 0; level < levels; level++)
+		{
+			//Level 0 reads the depth target, every other level the one above it
+			glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : texture);
+			program.set(sourceLevelUniform, level == 0 ? 0 : level - 1);
+			glBindImageTexture(0, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute((levelWidth + GROUP_SIZE - 1) / GROUP_SIZE, (levelHeight + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		timer.end();
+	}
+	// ------------------------------------------------------------------------
+	void bind(unsigned int unit) const
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+	// GPU time of the occluder draws plus the reduction
+	// ------------------------------------------------------------------------
+	double averageMs() const
+	{
+		return timer.averageMs();
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteTextures(1, &depthTexture);
+		glDeleteTextures(1, &texture);
+		glDeleteProgram(program.ID);
+		program.ID = 0;
+		timer.destroy();
+		framebuffer = depthTexture = texture = 0;
+		width = height = levels = 0;
+	}
+
+private:
+	static const int GROUP_SIZE = 8; // local_size_x and _y in hiz.comp
+	static const unsigned int REDUCE_UNIT = 0; // "source" in hiz.comp
+	Shader program;
+	Uniform<int> sourceLevelUniform;
+	unsigned int framebuffer = 0;
+	unsigned int depthTexture = 0;
+	int depthWidth = 0;
+	int depthHeight = 0;
+	GLint savedFramebuffer = 0;
+	GLint savedViewport[4] = {};
+	GpuTimer timer;
+};
+#endif
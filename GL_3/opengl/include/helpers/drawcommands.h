@@ -0,0 +1,167 @@
+#ifndef DRAWCOMMANDS_H
+#define DRAWCOMMANDS_H
+
+#include <glad/glad.h>
+#include <helpers/meshbuffer.h>
+#include <helpers/uploadcounter.h>
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+// layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+// ------------------------------------------------------------------------
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Draws of MeshBuffer meshes, sorted into buckets (one per shader/state combination) and
+// submitted with one glMultiDrawElementsIndirect per bucket, however many draws it holds.
+// Every draw carries a T, packed per bucket into a storage buffer bound to DATA_BINDING for the
+// bucket's call, so the shader reads its own with "draws[gl_DrawIDARB]".
+// Build once and upload() for a static scene, or clear() and rebuild when it changes.
+// A bucket holding meshes of both index types is drawn with one call per type.
+template<typename T>
+class DrawCommands
+{
+public:
+	static const unsigned int DATA_BINDING = 0; // std430 buffer binding in the shaders
+
+	// ------------------------------------------------------------------------
+	void create()
+	{
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &dataBuffer);
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		dataAlignment = std::max<size_t>(alignment, 1);
+	}
+	// forgets the draws, keeps buckets and memory
+	// ------------------------------------------------------------------------
+	void clear()
+	{
+		for (Bucket& bucket : buckets)
+		{
+			bucket.commands.clear();
+			bucket.data.clear();
+		}
+	}
+	// returns the draw's gl_DrawIDARB inside its bucket
+	// ------------------------------------------------------------------------
+	unsigned int add(unsigned int bucketId, const MeshBuffer::Mesh& mesh, const T& data, unsigned int instanceCount = 1, unsigned int baseInstance = 0)
+	{
+		Bucket& bucket = find(bucketId, mesh.indexType);
+		DrawElementsIndirectCommand command;
+		command.count = mesh.indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = mesh.firstIndex;
+		command.baseVertex = mesh.baseVertex;
+		command.baseInstance = baseInstance;
+		bucket.commands.push_back(command);
+		bucket.data.push_back(data);
+		return static_cast<unsigned int>(bucket.commands.size() - 1);
+	}
+	// packs every bucket into the two buffers, only grows them when they are too small
+	// ------------------------------------------------------------------------
+	void upload()
+	{
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<unsigned char> data;
+		for (Bucket& bucket : buckets)
+		{
+			bucket.commandOffset = commands.size() * sizeof(DrawElementsIndirectCommand);
+			commands.insert(commands.end(), bucket.commands.begin(), bucket.commands.end());
+
+			bucket.dataOffset = (data.size() + dataAlignment - 1) / dataAlignment * dataAlignment;
+			data.resize(bucket.dataOffset + bucket.data.size() * sizeof(T));
+			if (!bucket.data.empty())
+				memcpy(data.data() + bucket.dataOffset, bucket.data.data(), bucket.data.size() * sizeof(T));
+		}
+		write(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commandCapacity, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+		write(GL_SHADER_STORAGE_BUFFER, dataBuffer, dataCapacity, data.data(), data.size());
+	}
+	// one call for the whole bucket (per index type), needs the MeshBuffer bound and the bucket's shader in use
+	// ------------------------------------------------------------------------
+	void draw(unsigned int bucketId) const
+	{
+		for (const Bucket& bucket : buckets)
+		{
+			if (bucket.id != bucketId || bucket.commands.empty())
+				continue;
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DATA_BINDING, dataBuffer, bucket.dataOffset, bucket.data.size() * sizeof(T));
+			glMultiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType, (void*)bucket.commandOffset,
+				static_cast<GLsizei>(bucket.commands.size()), 0);
+		}
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &dataBuffer);
+		commandBuffer = dataBuffer = 0;
+		commandCapacity = dataCapacity = 0;
+		buckets.clear();
+	}
+	// ------------------------------------------------------------------------
+	size_t drawCount() const
+	{
+		size_t count = 0;
+		for (const Bucket& bucket : buckets)
+			count += bucket.commands.size();
+		return count;
+	}
+	size_t bucketCount() const
+	{
+		return buckets.size();
+	}
+
+private:
+	struct Bucket
+	{
+		unsigned int id = 0;
+		GLenum indexType = GL_UNSIGNED_INT; // of every mesh in it
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<T> data;
+		size_t commandOffset = 0; // bytes, set by upload()
+		size_t dataOffset = 0;
+	};
+	std::vector<Bucket> buckets; // few, a linear search is fine
+	unsigned int commandBuffer = 0;
+	unsigned int dataBuffer = 0;
+	size_t commandCapacity = 0;
+	size_t dataCapacity = 0;
+	size_t dataAlignment = 1;
+
+	Bucket& find(unsigned int bucketId, GLenum indexType)
+	{
+		for (Bucket& bucket : buckets)
+		{
+			if (bucket.id == bucketId && bucket.indexType == indexType)
+				return bucket;
+		}
+		buckets.push_back(Bucket());
+		buckets.back().id = bucketId;
+		buckets.back().indexType = indexType;
+		return buckets.back();
+	}
+	static void write(GLenum target, unsigned int buffer, size_t& capacity, const void* data, size_t bytes)
+	{
+		glBindBuffer(target, buffer);
+		if (bytes > capacity)
+		{
+			capacity = bytes;
+			UploadCounter::bufferData(target, bytes, data, GL_DYNAMIC_DRAW);
+		}
+		else if (bytes > 0)
+		{
+			UploadCounter::bufferSubData(target, 0, bytes, data);
+		}
+	}
+};
+#endif
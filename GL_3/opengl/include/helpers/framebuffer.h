@@ -0,0 +1,60 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// Offscreen render target (color + depth renderbuffers) for runs without a window
+class Framebuffer
+{
+public:
+	unsigned int ID = 0;
+	unsigned int colorBuffer = 0;
+	unsigned int depthBuffer = 0;
+	int width = 0;
+	int height = 0;
+
+	// allocates the attachments, returns false if the driver reports the FBO incomplete
+	// ------------------------------------------------------------------------
+	bool create(int width, int height)
+	{
+		this->width = width;
+		this->height = height;
+
+		glGenFramebuffers(1, &ID);
+		glBindFramebuffer(GL_FRAMEBUFFER, ID);
+
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER::NOT_COMPLETE" << std::endl;
+			return false;
+		}
+		glViewport(0, 0, width, height);
+		return true;
+	}
+	// ------------------------------------------------------------------------
+	void bind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, ID);
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteRenderbuffers(1, &depthBuffer);
+		glDeleteRenderbuffers(1, &colorBuffer);
+		glDeleteFramebuffers(1, &ID);
+		ID = colorBuffer = depthBuffer = 0;
+	}
+};
+#endif
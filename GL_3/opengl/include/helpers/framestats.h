@@ -0,0 +1,82 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+// Frame times of the last CAPACITY frames, percentiles computed on demand.
+// Single writer (the render thread calls push() once per frame), any number of
+// readers: every slot is an atomic and the write position is published with
+// release order, so report() never locks and never blocks the frame.
+class FrameStats
+{
+public:
+	static const unsigned int CAPACITY = 1024; // power of two
+	float hitchFactor = 2.0f; // a frame counts as a hitch when it takes longer than hitchFactor * p50
+
+	struct Report
+	{
+		unsigned int count = 0;
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		float max = 0.0f;
+		unsigned int hitches = 0;
+	};
+
+	// ------------------------------------------------------------------------
+	void push(float frameMs)
+	{
+		const unsigned int index = written.load(std::memory_order_relaxed);
+		samples[index & (CAPACITY - 1)].store(frameMs, std::memory_order_relaxed);
+		written.store(index + 1, std::memory_order_release);
+	}
+	// ------------------------------------------------------------------------
+	Report report() const
+	{
+		Report result;
+		const unsigned int end = written.load(std::memory_order_acquire);
+		result.count = end < CAPACITY ? end : CAPACITY;
+		if (result.count == 0)
+			return result;
+
+		std::vector<float> sorted(result.count);
+		for (unsigned int i = 0; i < result.count; i++)
+			sorted[i] = samples[(end - 1 - i) & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		std::sort(sorted.begin(), sorted.end());
+
+		result.p50 = percentile(sorted, 0.50f);
+		result.p95 = percentile(sorted, 0.95f);
+		result.p99 = percentile(sorted, 0.99f);
+		result.max = sorted.back();
+		const float hitchMs = result.p50 * hitchFactor;
+		result.hitches = static_cast<unsigned int>(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), hitchMs));
+		return result;
+	}
+	// ------------------------------------------------------------------------
+	void print() const
+	{
+		const Report stats = report();
+		std::cout << "Frame times (last " << stats.count << "): p50 " << stats.p50 << " ms, p95 " << stats.p95
+			<< " ms, p99 " << stats.p99 << " ms, max " << stats.max << " ms, hitches " << stats.hitches << std::endl;
+	}
+	// ------------------------------------------------------------------------
+	void reset()
+	{
+		written.store(0, std::memory_order_release);
+	}
+
+private:
+	std::atomic<float> samples[CAPACITY] = {};
+	std::atomic<unsigned int> written{ 0 }; // total frames pushed, wraps into the ring
+
+	// nearest rank
+	static float percentile(const std::vector<float>& sorted, float fraction)
+	{
+		const size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5f);
+		return sorted[rank];
+	}
+};
+#endif
@@ -0,0 +1,276 @@
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+#include <helpers/culling.h>
+#include <helpers/depthpyramid.h>
+#include <helpers/drawcommands.h>
+#include <helpers/gputimer.h>
+#include <helpers/meshbuffer.h>
+#include <helpers/shader.h>
+#include <helpers/uploadcounter.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Frustum culling and draw compaction on the GPU. Objects are grouped into one indirect draw per
+// bucket and mesh; cull() resets every instanceCount to 0, then a compute pass (cull.comp) tests
+// each object's world box and appends the survivors to their draw: an atomicAdd on the draw's
+// instanceCount gives the slot, baseInstance + slot is where the object's model index goes.
+// The vertex shader (GPU_CULLED) reads it back with gl_BaseInstanceARB + gl_InstanceID, so the
+// draws are submitted straight from the buffer the pass wrote and visibility never reaches the CPU.
+// Models are read from whatever buffer is bound to MODEL_BINDING, the one the vertex shader uses.
+// Given a DepthPyramid, objects that pass the frustum are also tested against it (occlusion).
+// The draws still hold last frame's survivors until the next cull(), which makes them the
+// occluders to draw into the pyramid first.
+class GpuCulling
+{
+public:
+	static const unsigned int INSTANCE_BINDING = 0; // "DrawData" in vert.vs, visible model indices
+	static const unsigned int MODEL_BINDING = 1; // "ObjectData", every model matrix
+	static const unsigned int OBJECT_BINDING = 2;
+	static const unsigned int COMMAND_BINDING = 3;
+	static const unsigned int STATS_BINDING = 4;
+	static const unsigned int PYRAMID_UNIT = 0; // "depthPyramid" in cull.comp
+	static const unsigned int GROUP_SIZE = 64; // local_size_x in cull.comp
+
+	// objects the passes since the last takeStats() removed, summed over those passes
+	struct Stats
+	{
+		unsigned long long culls = 0;
+		unsigned long long outsideFrustum = 0;
+		unsigned long long occluded = 0;
+	};
+
+	// ------------------------------------------------------------------------
+	bool create(const char* computePath)
+	{
+		ShaderSources sources;
+		if (!Shader::readCompute(computePath, sources) || !program.rebuild(sources))
+		{
+			std::cout << "ERROR::GPU_CULLING::PROGRAM_NOT_BUILT " << computePath << std::endl;
+			return false;
+		}
+		planesUniform = program.uniform<glm::vec4>("planes");
+		countUniform = program.uniform<int>("objectCount");
+		levelsUniform = program.uniform<int>("pyramidLevels");
+		glGenBuffers(1, &objectBuffer);
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &resetBuffer);
+		glGenBuffers(1, &instanceBuffer);
+		glGenBuffers(1, &statsBuffer);
+		const GLuint zero[STAT_COUNT] = {};
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+		UploadCounter::bufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(zero), zero, 0);
+		timer.create();
+		return true;
+	}
+	// model is the object's index into the models at MODEL_BINDING, the local box its mesh's bounds
+	// ------------------------------------------------------------------------
+	void add(unsigned int bucket, const MeshBuffer::Mesh& mesh, unsigned int model, const glm::vec3& localCenter, const glm::vec3& localExtent)
+	{
+		CullObject object;
+		object.center = localCenter;
+		object.model = model;
+		object.extent = localExtent;
+		object.command = findDraw(bucket, mesh);
+		objects.push_back(object);
+	}
+	// sorts the draws by bucket, reserves every draw's instance range and uploads it all once
+	// ------------------------------------------------------------------------
+	void upload()
+	{
+		std::vector<unsigned int> sorted(draws.size());
+		for (unsigned int i = 0; i < sorted.size(); i++)
+			sorted[i] = i;
+		std::stable_sort(sorted.begin(), sorted.end(), [this](unsigned int a, unsigned int b)
+		{
+			return draws[a].bucket != draws[b].bucket ? draws[a].bucket < draws[b].bucket : draws[a].mesh.indexType < draws[b].mesh.indexType;
+		});
+		std::vector<unsigned int> position(draws.size());
+		std::vector<DrawElementsIndirectCommand> commands(draws.size());
+		std::vector<unsigned int> instanceCounts(draws.size(), 0);
+		for (const CullObject& object : objects)
+			instanceCounts[object.command]++;
+		unsigned int firstInstance = 0;
+		for (unsigned int i = 0; i < sorted.size(); i++)
+		{
+			const Draw& draw = draws[sorted[i]];
+			position[sorted[i]] = i;
+			commands[i].count = draw.mesh.indexCount;
+			commands[i].instanceCount = 0; // counted up by the pass
+			commands[i].firstIndex = draw.mesh.firstIndex;
+			commands[i].baseVertex = draw.mesh.baseVertex;
+			commands[i].baseInstance = firstInstance;
+			firstInstance += instanceCounts[sorted[i]];
+		}
+		for (CullObject& object : objects)
+			object.command = position[object.command];
+		std::vector<Draw> ordered(draws.size());
+		for (unsigned int i = 0; i < sorted.size(); i++)
+			ordered[position[sorted[i]]] = draws[sorted[i]];
+		draws.swap(ordered);
+
+		const GLsizeiptr commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+		UploadCounter::bufferStorage(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(CullObject), objects.data(), 0);
+		glBindBuffer(GL_COPY_READ_BUFFER, resetBuffer);
+		UploadCounter::bufferStorage(GL_COPY_READ_BUFFER, commandBytes, commands.data(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		UploadCounter::bufferStorage(GL_DRAW_INDIRECT_BUFFER, commandBytes, commands.data(), 0); // no occluders before the first cull()
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(objects.size(), 1) * sizeof(GLuint), NULL, 0);
+	}
+	// resets the draws from the copy upload() kept, then culls every object into them,
+	// against pyramid as well when one is given (built this frame, from the same camera)
+	// ------------------------------------------------------------------------
+	void cull(const Frustum& frustum, const DepthPyramid* pyramid = nullptr)
+	{
+		if (objects.empty())
+			return;
+		glBindBuffer(GL_COPY_READ_BUFFER, resetBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, draws.size() * sizeof(DrawElementsIndirectCommand));
+
+		timer.begin();
+		program.use();
+		glUniform4fv(planesUniform.location, 6, &frustum.planes[0][0]);
+		program.set(countUniform, static_cast<int>(objects.size()));
+		program.set(levelsUniform, pyramid != nullptr ? pyramid->levels : 0);
+		if (pyramid != nullptr)
+			pyramid->bind(PYRAMID_UNIT);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_BINDING, statsBuffer);
+		glDispatchCompute(static_cast<GLuint>((objects.size() + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+		timer.end();
+		culls++;
+
+		//The draws read what the pass wrote, as commands and from the vertex shader
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+	// every draw of bucket in one call per index type, needs the MeshBuffer bound and a GPU_CULLED shader in use
+	// ------------------------------------------------------------------------
+	void draw(unsigned int bucket) const
+	{
+		unsigned int first = 0;
+		while (first < draws.size() && draws[first].bucket != bucket)
+			first++;
+		if (first == draws.size())
+			return;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer);
+		while (first < draws.size() && draws[first].bucket == bucket)
+		{
+			unsigned int end = first;
+			while (end < draws.size() && draws[end].bucket == bucket && draws[end].mesh.indexType == draws[first].mesh.indexType)
+				end++;
+			glMultiDrawElementsIndirect(GL_TRIANGLES, draws[first].mesh.indexType, (void*)(first * sizeof(DrawElementsIndirectCommand)), static_cast<GLsizei>(end - first), 0);
+			first = end;
+		}
+	}
+	// objects that survived the last cull(), reads the counters back and so waits for the GPU
+	// ------------------------------------------------------------------------
+	size_t readVisible() const
+	{
+		std::vector<DrawElementsIndirectCommand> commands(draws.size());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		size_t visible = 0;
+		for (const DrawElementsIndirectCommand& command : commands)
+			visible += command.instanceCount;
+		return visible;
+	}
+	// reads the counters back and starts them over, waits for the GPU; the GPU counts in 32 bits,
+	// so long runs should take them every now and then
+	// ------------------------------------------------------------------------
+	Stats takeStats()
+	{
+		GLuint counters[STAT_COUNT] = {};
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		Stats stats;
+		stats.culls = culls;
+		stats.outsideFrustum = counters[0];
+		stats.occluded = counters[1];
+		culls = 0;
+		return stats;
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteBuffers(1, &objectBuffer);
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &resetBuffer);
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteBuffers(1, &statsBuffer);
+		glDeleteProgram(program.ID);
+		program.ID = 0;
+		timer.destroy();
+		objectBuffer = commandBuffer = resetBuffer = instanceBuffer = statsBuffer = 0;
+		culls = 0;
+		objects.clear();
+		draws.clear();
+	}
+	// ------------------------------------------------------------------------
+	size_t objectCount() const
+	{
+		return objects.size();
+	}
+	size_t drawCount() const
+	{
+		return draws.size();
+	}
+	// average GPU time of the pass, 0 until the first query came back
+	double averageMs() const
+	{
+		return timer.averageMs();
+	}
+
+private:
+	static const unsigned int STAT_COUNT = 2; // "CullStats" in cull.comp
+
+	// std430 "CullObject" in cull.comp, the vec3s pack with the uint after them
+	struct CullObject
+	{
+		glm::vec3 center;
+		GLuint model;
+		glm::vec3 extent;
+		GLuint command; // index of the object's draw
+	};
+	struct Draw
+	{
+		unsigned int bucket;
+		MeshBuffer::Mesh mesh;
+	};
+	Shader program;
+	Uniform<glm::vec4> planesUniform;
+	Uniform<int> countUniform;
+	Uniform<int> levelsUniform;
+	std::vector<CullObject> objects;
+	std::vector<Draw> draws; // by bucket after upload(), same order as the commands
+	unsigned int objectBuffer = 0;
+	unsigned int commandBuffer = 0; // indirect draws, written by the pass
+	unsigned int resetBuffer = 0; // the draws with instanceCount 0, copied over commandBuffer each cull()
+	unsigned int instanceBuffer = 0; // visible model indices, a range per draw
+	unsigned int statsBuffer = 0; // CullStats, counted up by the pass
+	unsigned long long culls = 0; // since the last takeStats()
+	GpuTimer timer;
+
+	unsigned int findDraw(unsigned int bucket, const MeshBuffer::Mesh& mesh)
+	{
+		for (unsigned int i = 0; i < draws.size(); i++)
+		{
+			if (draws[i].bucket == bucket && draws[i].mesh.firstIndex == mesh.firstIndex && draws[i].mesh.baseVertex == mesh.baseVertex && draws[i].mesh.indexCount == mesh.indexCount
+				&& draws[i].mesh.indexType == mesh.indexType)
+				return i;
+		}
+		draws.push_back(Draw{ bucket, mesh });
+		return static_cast<unsigned int>(draws.size() - 1);
+	}
+};
+#endif
@@ -0,0 +1,57 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of one span of commands per frame (GL_TIME_ELAPSED), averaged over the run.
+// Results are read QUERY_LATENCY frames late, by then they are ready and reading never stalls.
+// Spans of different timers must not overlap, GL allows one elapsed-time query at a time.
+class GpuTimer
+{
+public:
+	// ------------------------------------------------------------------------
+	void create()
+	{
+		glGenQueries(QUERY_LATENCY, queries);
+	}
+	// ------------------------------------------------------------------------
+	void begin()
+	{
+		const unsigned int slot = frame % QUERY_LATENCY;
+		if (frame >= QUERY_LATENCY)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+			seconds += nanoseconds * 1e-9;
+			timedFrames++;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+	}
+	void end()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		frame++;
+	}
+	// ------------------------------------------------------------------------
+	double averageMs() const
+	{
+		return timedFrames > 0 ? seconds * 1000.0 / timedFrames : 0.0;
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteQueries(QUERY_LATENCY, queries);
+		for (unsigned int& query : queries)
+			query = 0;
+		frame = timedFrames = 0;
+		seconds = 0.0;
+	}
+
+private:
+	static const unsigned int QUERY_LATENCY = 3;
+	unsigned int queries[QUERY_LATENCY] = {};
+	unsigned long long frame = 0;
+	unsigned long long timedFrames = 0;
+	double seconds = 0.0;
+};
+#endif
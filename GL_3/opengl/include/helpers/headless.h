@@ -0,0 +1,114 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// keep Xlib out, we never talk to a display server
+#ifndef EGL_NO_X11
+#define EGL_NO_X11
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <iostream>
+#include <string>
+
+// Window-less OpenGL context through EGL. On Mesa this is the surfaceless
+// platform (llvmpipe on machines without display or GPU), elsewhere the default display.
+// There is no default framebuffer, so everything has to be rendered into an FBO.
+class HeadlessContext
+{
+public:
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	// creates a core profile context of the given version and makes it current
+	// ------------------------------------------------------------------------
+	bool create(int major, int minor)
+	{
+		display = getDisplay();
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+		{
+			std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+			return false;
+		}
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cout << "ERROR::HEADLESS::OPENGL_API_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+
+		// surfaceless contexts don't need a config, fall back to any desktop GL one
+		EGLConfig config = (EGLConfig)0;
+		if (!hasExtension("EGL_KHR_no_config_context"))
+		{
+			const EGLint configAttributes[] = {
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+				EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+				EGL_NONE
+			};
+			EGLint configCount = 0;
+			if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+			{
+				std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+				return false;
+			}
+		}
+
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, major,
+			EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context == EGL_NO_CONTEXT)
+		{
+			std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+			return false;
+		}
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		if (display == EGL_NO_DISPLAY)
+			return;
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext(display, context);
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+		context = EGL_NO_CONTEXT;
+	}
+	// loader for gladLoadGLLoader
+	// ------------------------------------------------------------------------
+	static void* getProcAddress(const char* name)
+	{
+		return (void*)eglGetProcAddress(name);
+	}
+
+private:
+	EGLDisplay getDisplay()
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (getPlatformDisplay != NULL && clientExtensions != NULL
+			&& std::string(clientExtensions).find("EGL_MESA_platform_surfaceless") != std::string::npos)
+		{
+			return getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	// ------------------------------------------------------------------------
+	bool hasExtension(const char* name)
+	{
+		const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+		return extensions != NULL && std::string(extensions).find(name) != std::string::npos;
+	}
+};
+#endif
@@ -0,0 +1,63 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+#include <helpers/meshview.h>
+#include <helpers/uploadcounter.h>
+
+// Per-instance model matrices read as a vertex attribute (divisor 1), "layout (location = 1) in mat4 model"
+// in shaders built with INSTANCED. A mat4 takes four attribute slots, LOCATION to LOCATION + 3.
+// One instanced draw then covers any number of copies of a mesh, the baseInstance of the draw
+// picks where in this buffer its matrices start.
+class InstanceBuffer
+{
+public:
+	static const unsigned int LOCATION = 1;
+	unsigned int ID = 0;
+
+	// ------------------------------------------------------------------------
+	void create(Span<const glm::mat4> transforms)
+	{
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		UploadCounter::bufferStorage(GL_ARRAY_BUFFER, transforms.bytes(), transforms.data, GL_DYNAMIC_STORAGE_BIT);
+		count = transforms.count;
+	}
+	// sets up the attributes on vao (bound afterwards)
+	// ------------------------------------------------------------------------
+	void attach(unsigned int vao) const
+	{
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glVertexAttribPointer(LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(LOCATION + column, 1);
+			glEnableVertexAttribArray(LOCATION + column);
+		}
+	}
+	// overwrites instances first to first + transforms.count
+	// ------------------------------------------------------------------------
+	void update(size_t first, Span<const glm::mat4> transforms)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		UploadCounter::bufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::mat4), transforms.bytes(), transforms.data);
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteBuffers(1, &ID);
+		ID = 0;
+		count = 0;
+	}
+	// ------------------------------------------------------------------------
+	size_t size() const
+	{
+		return count;
+	}
+
+private:
+	size_t count = 0;
+};
+#endif
@@ -0,0 +1,263 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for per-frame CPU work (culling, command building, transforms).
+// Every thread has its own deque: it pushes and pops its newest work at the back, idle threads
+// steal the oldest work from the front of the others. The main thread is slot 0 and runs work
+// whenever it waits, so start(0) still works (everything then runs inline on the main thread).
+// Tasks live until endFrame(), a task only runs once all tasks it depends on have finished.
+class JobSystem
+{
+public:
+	struct Task
+	{
+		std::function<void()> work;
+		std::atomic<int> pending{ 1 }; // unfinished dependencies, +1 until add() has registered them
+		std::atomic<bool> done{ false }; // set last, the task may be freed right after
+		std::mutex mutex; // guards finished and dependents against a dependency finishing while it is added
+		bool finished = false;
+		std::vector<Task*> dependents;
+	};
+
+	// ------------------------------------------------------------------------
+	void start(unsigned int workerCount)
+	{
+		stop();
+		stopping = false;
+		queues.clear();
+		for (unsigned int i = 0; i <= workerCount; i++)
+			queues.emplace_back(new Queue());
+		threadSlot() = 0;
+		for (unsigned int i = 1; i <= workerCount; i++)
+			workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+	// ------------------------------------------------------------------------
+	void stop()
+	{
+		if (!workers.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+			workers.clear();
+		}
+		frameTasks.clear();
+	}
+	// worker threads plus the main thread
+	// ------------------------------------------------------------------------
+	unsigned int threadCount() const
+	{
+		return static_cast<unsigned int>(std::max<size_t>(queues.size(), 1));
+	}
+	// task for this frame, runs once every task in dependencies has finished (NULL ones are skipped,
+	// for optional steps), call from the main thread
+	// ------------------------------------------------------------------------
+	Task* add(std::function<void()> work, std::initializer_list<Task*> dependencies = {})
+	{
+		frameTasks.emplace_back(new Task());
+		Task* task = frameTasks.back().get();
+		task->work = std::move(work);
+		for (Task* dependency : dependencies)
+		{
+			if (dependency == NULL)
+				continue;
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (dependency->finished)
+				continue;
+			task->pending++;
+			dependency->dependents.push_back(task);
+		}
+		release(task);
+		return task;
+	}
+	// runs other work until task has finished
+	// ------------------------------------------------------------------------
+	void wait(const Task* task)
+	{
+		while (!task->done)
+		{
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+	// waits for every task of the frame, then frees them
+	// ------------------------------------------------------------------------
+	void endFrame()
+	{
+		for (const std::unique_ptr<Task>& task : frameTasks)
+			wait(task.get());
+		frameTasks.clear();
+	}
+	// body(first, end) over [0, count) in pieces of at least grain items, returns when all are done.
+	// The calling thread takes part, so this may be used from inside a task.
+	// ------------------------------------------------------------------------
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+	{
+		if (count == 0)
+			return;
+		grain = std::max<size_t>(grain, 1);
+		const size_t pieces = std::min<size_t>((count + grain - 1) / grain, threadCount() * 4);
+		if (pieces <= 1)
+		{
+			body(0, count);
+			return;
+		}
+		std::atomic<size_t> remaining(pieces);
+		for (size_t piece = 1; piece < pieces; piece++)
+		{
+			const size_t first = count * piece / pieces;
+			const size_t end = count * (piece + 1) / pieces;
+			push([&body, &remaining, first, end]()
+			{
+				body(first, end);
+				remaining--;
+			});
+		}
+		body(0, count / pieces);
+		remaining--;
+		while (remaining > 0)
+		{
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+	// ------------------------------------------------------------------------
+	unsigned long long executed() const
+	{
+		return executedCount;
+	}
+	unsigned long long steals() const
+	{
+		return stealCount;
+	}
+	void printStats() const
+	{
+		std::cout << "Jobs: " << threadCount() << " threads, " << executedCount << " work items, " << stealCount << " stolen" << std::endl;
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> items;
+	};
+	std::vector<std::unique_ptr<Queue>> queues; // [0] is the main thread
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Task>> frameTasks;
+	std::atomic<int> queued{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::atomic<unsigned long long> executedCount{ 0 };
+	std::atomic<unsigned long long> stealCount{ 0 };
+
+	// index of the calling thread's queue
+	static unsigned int& threadSlot()
+	{
+		static thread_local unsigned int slot = 0;
+		return slot;
+	}
+	// ------------------------------------------------------------------------
+	void push(std::function<void()> item)
+	{
+		Queue& queue = *queues[threadSlot()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.items.push_back(std::move(item));
+		}
+		queued++;
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex); // a worker between checking queued and sleeping
+		}
+		wake.notify_one();
+	}
+	// own newest work first, then the oldest of the other threads
+	// ------------------------------------------------------------------------
+	bool runOne()
+	{
+		const unsigned int self = threadSlot();
+		std::function<void()> item;
+		if (!popBack(*queues[self], item))
+		{
+			bool stolen = false;
+			for (size_t i = 1; i < queues.size() && !stolen; i++)
+				stolen = popFront(*queues[(self + i) % queues.size()], item);
+			if (!stolen)
+				return false;
+			stealCount++;
+		}
+		queued--;
+		item();
+		executedCount++;
+		return true;
+	}
+	static bool popBack(Queue& queue, std::function<void()>& item)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.items.empty())
+			return false;
+		item = std::move(queue.items.back());
+		queue.items.pop_back();
+		return true;
+	}
+	static bool popFront(Queue& queue, std::function<void()>& item)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.items.empty())
+			return false;
+		item = std::move(queue.items.front());
+		queue.items.pop_front();
+		return true;
+	}
+	// drops the hold add() or a finished dependency had, queues the task once none are left
+	// ------------------------------------------------------------------------
+	void release(Task* task)
+	{
+		if (--task->pending > 0)
+			return;
+		push([this, task]()
+		{
+			task->work();
+			std::vector<Task*> dependents;
+			{
+				std::lock_guard<std::mutex> lock(task->mutex);
+				task->finished = true;
+				dependents.swap(task->dependents);
+			}
+			for (Task* dependent : dependents)
+				release(dependent);
+			task->done = true;
+		});
+	}
+	// ------------------------------------------------------------------------
+	void workerLoop(unsigned int slot)
+	{
+		threadSlot() = slot;
+		while (true)
+		{
+			if (runOne())
+				continue;
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return stopping || queued > 0; });
+			if (stopping)
+				return;
+		}
+	}
+};
+#endif
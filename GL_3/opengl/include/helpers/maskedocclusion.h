@@ -0,0 +1,421 @@
+#ifndef MASKEDOCCLUSION_H
+#define MASKEDOCCLUSION_H
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/simd/platform.h> // GLM_ARCH and the intrinsics header it implies
+#include <helpers/jobsystem.h>
+#include <helpers/meshview.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Occlusion culling on the CPU, after Masked Software Occlusion Culling (Andersson, Hasselgren,
+// Akenine-Moeller). The depth buffer is low resolution and made of 8x4 pixel tiles; a tile keeps
+// no depth per pixel, only zMax0, behind which all of it is hidden, and a working layer: the pixels
+// its triangles covered so far (a 32 bit mask) and the farthest of their depths. Once the working
+// layer covers the tile it becomes the new zMax0.
+// Occluders go in with add(), render() then transforms and bins their triangles on several jobs
+// and rasterizes every bin on its own job, so no tile is written by two threads. The coverage of a
+// tile is one SIMD compare per row and edge (8 lanes with AVX2, two halves with SSE2).
+// Depth is GL's window depth, 1 is far. Everything errs towards visible: a pixel only counts as
+// covered when the whole of it is inside the triangle, a triangle's depth in a tile is the
+// farthest its plane reaches there, and triangles crossing the camera plane are left out.
+class MaskedOcclusion
+{
+public:
+	static const int TILE_WIDTH = 8;
+	static const int TILE_HEIGHT = 4;
+
+	// ------------------------------------------------------------------------
+	static const char* path()
+	{
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+		return "AVX2, 8 lanes";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		return "SSE2, 4 lanes";
+#else
+		return "scalar";
+#endif
+	}
+	// size in pixels, rounded up to whole tiles
+	// ------------------------------------------------------------------------
+	void resize(int width, int height)
+	{
+		tilesX = std::max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+		tilesY = std::max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+		zMax0.resize(tilesX * tilesY);
+		zMax1.resize(tilesX * tilesY);
+		masks.resize(tilesX * tilesY);
+		clear();
+	}
+	// starts a frame: empty buffer, no occluders
+	// ------------------------------------------------------------------------
+	void begin(const glm::mat4& viewProjection)
+	{
+		camera = viewProjection;
+		occluders.clear();
+		clear();
+	}
+	// mesh must stay alive until render()
+	// ------------------------------------------------------------------------
+	void add(const MeshView& mesh, const glm::mat4& model)
+	{
+		occluders.push_back(Occluder{ &mesh, camera * model });
+	}
+	// rasterizes every occluder added since begin(), on the calling thread when jobs is nullptr
+	// ------------------------------------------------------------------------
+	void render(JobSystem* jobs)
+	{
+		renderWith<true>(jobs);
+	}
+	void renderScalar(JobSystem* jobs)
+	{
+		renderWith<false>(jobs);
+	}
+	// world space box (center/extent), false only if every tile it covers is nearer than its nearest point
+	// ------------------------------------------------------------------------
+	bool visible(const glm::vec3& center, const glm::vec3& extent) const
+	{
+		glm::vec2 low(1e30f), high(-1e30f);
+		float nearest = 1.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			const glm::vec3 corner = center + extent * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+			const glm::vec4 clip = camera * glm::vec4(corner, 1.0f);
+			if (clip.w <= W_EPSILON)
+				return true;
+			const glm::vec2 pixel = toPixels(clip);
+			low = glm::min(low, pixel);
+			high = glm::max(high, pixel);
+			nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+		}
+		const int firstX = std::max(0, static_cast<int>(std::floor(low.x)) / TILE_WIDTH);
+		const int firstY = std::max(0, static_cast<int>(std::floor(low.y)) / TILE_HEIGHT);
+		const int lastX = std::min(tilesX - 1, static_cast<int>(std::floor(high.x)) / TILE_WIDTH);
+		const int lastY = std::min(tilesY - 1, static_cast<int>(std::floor(high.y)) / TILE_HEIGHT);
+		if (high.x < 0.0f || high.y < 0.0f || firstX > lastX || firstY > lastY)
+			return true; // off screen, left to the frustum
+		for (int y = firstY; y <= lastY; y++)
+		{
+			for (int x = firstX; x <= lastX; x++)
+			{
+				if (nearest <= zMax0[y * tilesX + x])
+					return true;
+			}
+		}
+		return false;
+	}
+	// ------------------------------------------------------------------------
+	int width() const
+	{
+		return tilesX * TILE_WIDTH;
+	}
+	int height() const
+	{
+		return tilesY * TILE_HEIGHT;
+	}
+	size_t occluderCount() const
+	{
+		return occluders.size();
+	}
+	// triangles of the last render() that reached at least one pixel center
+	size_t rasterizedTriangles() const
+	{
+		return rasterized;
+	}
+	// farthest depth of tile (x, y) that still hides what is behind it
+	float tileDepth(int x, int y) const
+	{
+		return zMax0[y * tilesX + x];
+	}
+
+private:
+	static const int BIN_COLUMNS = 4;
+	static const int BIN_ROWS = 4;
+	static const uint32_t FULL_MASK = 0xFFFFFFFFu;
+	static constexpr float W_EPSILON = 1e-5f;
+
+	struct Occluder
+	{
+		const MeshView* mesh;
+		glm::mat4 mvp;
+	};
+	// edge i inside where a[i] * x + b[i] * y + c[i] >= 0 at a pixel center, depth = zA * x + zB * y + zC
+	struct Triangle
+	{
+		float a[3], b[3], c[3];
+		float zA, zB, zC, zMax;
+		int firstX, firstY, lastX, lastY; // tiles
+	};
+	// what one binning job produced: its triangles and, per bin, the ones touching it
+	struct Chunk
+	{
+		std::vector<glm::vec4> clip;
+		std::vector<Triangle> triangles;
+		std::vector<uint32_t> bins[BIN_COLUMNS * BIN_ROWS];
+	};
+
+	glm::mat4 camera = glm::mat4(1.0f);
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<float> zMax0;
+	std::vector<float> zMax1;
+	std::vector<uint32_t> masks;
+	std::vector<Occluder> occluders;
+	std::vector<Chunk> chunks;
+	size_t rasterized = 0;
+
+	void clear()
+	{
+		std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+		std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+		std::fill(masks.begin(), masks.end(), 0u);
+	}
+	glm::vec2 toPixels(const glm::vec4& clip) const
+	{
+		return glm::vec2((clip.x / clip.w * 0.5f + 0.5f) * width(), (clip.y / clip.w * 0.5f + 0.5f) * height());
+	}
+
+	template<bool SIMD>
+	void renderWith(JobSystem* jobs)
+	{
+		//Fixed chunks, so the bins are filled and read back in the same order on any thread count
+		const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(occluders.size(), jobs != nullptr ? jobs->threadCount() * 4 : 1));
+		chunks.resize(chunkCount);
+		auto bin = [this, chunkCount](size_t first, size_t end)
+		{
+			for (size_t c = first; c < end; c++)
+				binChunk(chunks[c], occluders.size() * c / chunkCount, occluders.size() * (c + 1) / chunkCount);
+		};
+		auto rasterize = [this](size_t first, size_t end)
+		{
+			for (size_t b = first; b < end; b++)
+				rasterizeBin<SIMD>(static_cast<int>(b));
+		};
+		if (jobs != nullptr)
+		{
+			jobs->parallelFor(chunkCount, 1, bin);
+			jobs->parallelFor(BIN_COLUMNS * BIN_ROWS, 1, rasterize);
+		}
+		else
+		{
+			bin(0, chunkCount);
+			rasterize(0, BIN_COLUMNS * BIN_ROWS);
+		}
+		rasterized = 0;
+		for (size_t c = 0; c < chunkCount; c++)
+			rasterized += chunks[c].triangles.size();
+	}
+
+	// transform, set up and bin the triangles of occluders first to end
+	void binChunk(Chunk& chunk, size_t first, size_t end)
+	{
+		chunk.triangles.clear();
+		for (std::vector<uint32_t>& list : chunk.bins)
+			list.clear();
+		for (size_t o = first; o < end; o++)
+		{
+			const MeshView& mesh = *occluders[o].mesh;
+			chunk.clip.resize(mesh.vertices.count);
+			for (size_t v = 0; v < mesh.vertices.count; v++)
+				chunk.clip[v] = occluders[o].mvp * glm::vec4(mesh.vertices[v], 1.0f);
+			for (size_t t = 0; t < mesh.triangleCount(); t++)
+			{
+				Triangle triangle;
+				if (!setup(chunk.clip[mesh.indices[t * 3]], chunk.clip[mesh.indices[t * 3 + 1]], chunk.clip[mesh.indices[t * 3 + 2]], triangle))
+					continue;
+				const uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+				chunk.triangles.push_back(triangle);
+				for (int by = binRow(triangle.firstY); by <= binRow(triangle.lastY); by++)
+				{
+					for (int bx = binColumn(triangle.firstX); bx <= binColumn(triangle.lastX); bx++)
+						chunk.bins[by * BIN_COLUMNS + bx].push_back(index);
+				}
+			}
+		}
+	}
+	int binColumn(int tileX) const
+	{
+		return tileX * BIN_COLUMNS / tilesX;
+	}
+	int binRow(int tileY) const
+	{
+		return tileY * BIN_ROWS / tilesY;
+	}
+
+	// false for triangles that cover no pixel or cross the camera plane
+	bool setup(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2, Triangle& triangle) const
+	{
+		if (clip0.w <= W_EPSILON || clip1.w <= W_EPSILON || clip2.w <= W_EPSILON)
+			return false;
+		glm::vec3 v[3];
+		const glm::vec4* clips[3] = { &clip0, &clip1, &clip2 };
+		for (int i = 0; i < 3; i++)
+			v[i] = glm::vec3(toPixels(*clips[i]), clips[i]->z / clips[i]->w * 0.5f + 0.5f);
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::fabs(area) < 1e-6f)
+			return false;
+		//Counter-clockwise on screen, then inside is where all three edges are positive
+		if (area < 0.0f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		const float minX = std::min(v[0].x, std::min(v[1].x, v[2].x)), maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+		const float minY = std::min(v[0].y, std::min(v[1].y, v[2].y)), maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+		const int pixelX0 = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+		const int pixelY0 = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+		const int pixelX1 = std::min(width() - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+		const int pixelY1 = std::min(height() - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+		if (pixelX0 > pixelX1 || pixelY0 > pixelY1)
+			return false;
+		triangle.firstX = pixelX0 / TILE_WIDTH;
+		triangle.firstY = pixelY0 / TILE_HEIGHT;
+		triangle.lastX = pixelX1 / TILE_WIDTH;
+		triangle.lastY = pixelY1 / TILE_HEIGHT;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec3& p = v[i];
+			const glm::vec3& q = v[(i + 1) % 3];
+			triangle.a[i] = p.y - q.y;
+			triangle.b[i] = q.x - p.x;
+			//Moved inwards by half a pixel's reach, so a positive center means the whole pixel is inside
+			triangle.c[i] = p.x * q.y - p.y * q.x - 0.5f * (std::fabs(triangle.a[i]) + std::fabs(triangle.b[i]));
+		}
+		triangle.zA = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+		triangle.zB = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+		triangle.zC = v[0].z - triangle.zA * v[0].x - triangle.zB * v[0].y;
+		triangle.zMax = std::max(v[0].z, std::max(v[1].z, v[2].z));
+		return true;
+	}
+
+	template<bool SIMD>
+	void rasterizeBin(int bin)
+	{
+		const int bx = bin % BIN_COLUMNS, by = bin / BIN_COLUMNS;
+		const int binX0 = (bx * tilesX + BIN_COLUMNS - 1) / BIN_COLUMNS, binX1 = ((bx + 1) * tilesX + BIN_COLUMNS - 1) / BIN_COLUMNS - 1;
+		const int binY0 = (by * tilesY + BIN_ROWS - 1) / BIN_ROWS, binY1 = ((by + 1) * tilesY + BIN_ROWS - 1) / BIN_ROWS - 1;
+		for (const Chunk& chunk : chunks)
+		{
+			for (uint32_t index : chunk.bins[bin])
+			{
+				const Triangle& triangle = chunk.triangles[index];
+				const int lastY = std::min(triangle.lastY, binY1), lastX = std::min(triangle.lastX, binX1);
+				for (int y = std::max(triangle.firstY, binY0); y <= lastY; y++)
+				{
+					for (int x = std::max(triangle.firstX, binX0); x <= lastX; x++)
+					{
+						const size_t tile = static_cast<size_t>(y) * tilesX + x;
+						//Farthest the plane gets over the tile, never past the triangle's own far vertex
+						const float tileX0 = static_cast<float>(x * TILE_WIDTH), tileY0 = static_cast<float>(y * TILE_HEIGHT);
+						const float depth = std::min(triangle.zMax, triangle.zC
+							+ std::max(triangle.zA * tileX0, triangle.zA * (tileX0 + TILE_WIDTH))
+							+ std::max(triangle.zB * tileY0, triangle.zB * (tileY0 + TILE_HEIGHT)));
+						if (depth >= zMax0[tile])
+							continue;
+						const uint32_t coverage = SIMD ? coverageSimd(triangle, tileX0, tileY0) : coverageScalar(triangle, tileX0, tileY0);
+						if (coverage != 0)
+							update(tile, coverage, depth);
+					}
+				}
+			}
+		}
+	}
+
+	// merges a triangle into the tile's working layer, see the class comment
+	void update(size_t tile, uint32_t coverage, float depth)
+	{
+		//A triangle much nearer than the working layer starts a new one, the old one would only hold it back
+		if (zMax1[tile] - depth > zMax0[tile] - zMax1[tile])
+		{
+			zMax1[tile] = 0.0f;
+			masks[tile] = 0u;
+		}
+		zMax1[tile] = std::max(zMax1[tile], depth);
+		masks[tile] |= coverage;
+		if (masks[tile] == FULL_MASK)
+		{
+			zMax0[tile] = zMax1[tile];
+			zMax1[tile] = 0.0f;
+			masks[tile] = 0u;
+		}
+	}
+
+	// bit y * TILE_WIDTH + x for pixel (x, y) of the tile, set when the pixel is inside all three edges
+	static uint32_t coverageScalar(const Triangle& triangle, float tileX0, float tileY0)
+	{
+		uint32_t coverage = 0;
+		for (int y = 0; y < TILE_HEIGHT; y++)
+		{
+			const float py = tileY0 + y + 0.5f;
+			for (int x = 0; x < TILE_WIDTH; x++)
+			{
+				const float px = tileX0 + x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+					inside = inside && triangle.a[e] * px + (triangle.b[e] * py + triangle.c[e]) >= 0.0f;
+				coverage |= inside ? 1u << (y * TILE_WIDTH + x) : 0u;
+			}
+		}
+		return coverage;
+	}
+
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	static uint32_t coverageSimd(const Triangle& triangle, float tileX0, float tileY0)
+	{
+		const __m256 px = _mm256_add_ps(_mm256_set1_ps(tileX0), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+		__m256 ax[3];
+		for (int e = 0; e < 3; e++)
+			ax[e] = _mm256_mul_ps(_mm256_set1_ps(triangle.a[e]), px);
+		const __m256 zero = _mm256_setzero_ps();
+		uint32_t coverage = 0;
+		for (int y = 0; y < TILE_HEIGHT; y++)
+		{
+			const float py = tileY0 + y + 0.5f;
+			__m256 inside = _mm256_cmp_ps(_mm256_add_ps(ax[0], _mm256_set1_ps(triangle.b[0] * py + triangle.c[0])), zero, _CMP_GE_OQ);
+			for (int e = 1; e < 3; e++)
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(ax[e], _mm256_set1_ps(triangle.b[e] * py + triangle.c[e])), zero, _CMP_GE_OQ));
+			coverage |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (y * TILE_WIDTH);
+		}
+		return coverage;
+	}
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+	static uint32_t coverageSimd(const Triangle& triangle, float tileX0, float tileY0)
+	{
+		const __m128 left = _mm_add_ps(_mm_set1_ps(tileX0), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+		const __m128 right = _mm_add_ps(_mm_set1_ps(tileX0), _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f));
+		__m128 axLeft[3], axRight[3];
+		for (int e = 0; e < 3; e++)
+		{
+			axLeft[e] = _mm_mul_ps(_mm_set1_ps(triangle.a[e]), left);
+			axRight[e] = _mm_mul_ps(_mm_set1_ps(triangle.a[e]), right);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t coverage = 0;
+		for (int y = 0; y < TILE_HEIGHT; y++)
+		{
+			const float py = tileY0 + y + 0.5f;
+			__m128 insideLeft = _mm_castsi128_ps(_mm_set1_epi32(-1)), insideRight = insideLeft;
+			for (int e = 0; e < 3; e++)
+			{
+				const __m128 row = _mm_set1_ps(triangle.b[e] * py + triangle.c[e]);
+				insideLeft = _mm_and_ps(insideLeft, _mm_cmpge_ps(_mm_add_ps(axLeft[e], row), zero));
+				insideRight = _mm_and_ps(insideRight, _mm_cmpge_ps(_mm_add_ps(axRight[e], row), zero));
+			}
+			const uint32_t bits = static_cast<uint32_t>(_mm_movemask_ps(insideLeft)) | static_cast<uint32_t>(_mm_movemask_ps(insideRight)) << 4;
+			coverage |= bits << (y * TILE_WIDTH);
+		}
+		return coverage;
+	}
+#else
+	static uint32_t coverageSimd(const Triangle& triangle, float tileX0, float tileY0)
+	{
+		return coverageScalar(triangle, tileX0, tileY0);
+	}
+#endif
+};
+#endif
@@ -0,0 +1,186 @@
+#ifndef MESHBUFFER_H
+#define MESHBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+#include <helpers/meshview.h>
+#include <helpers/uploadcounter.h>
+#include <helpers/vertexformat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+// One vertex and one index buffer holding every mesh, uploaded once and never reallocated.
+// add() only appends to CPU-side arrays, upload() creates immutable GPU storage for all of them.
+// A mesh is then just an offset into the shared buffers, so switching between meshes or drawing
+// many different ones per frame needs no buffer binds and no uploads.
+// Positions are stored in the VertexFormat upload() is given (attribute 0, declared once in
+// layout), indices as 16-bit for every mesh with at most 65536 vertices and 32-bit otherwise.
+// Draws of meshes with different index types can't share a multi-draw call, see Mesh::indexType.
+class MeshBuffer
+{
+public:
+	// where a mesh lives inside the shared buffers
+	struct Mesh
+	{
+		int baseVertex = 0; // added to every index
+		unsigned int firstIndex = 0; // in indexType units, as indirect draws count it
+		unsigned int indexCount = 0;
+		GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT when the mesh has at most 65536 vertices
+	};
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	unsigned int EBO = 0;
+	VertexLayout layout; // set by upload()
+
+	// indices are relative to the mesh's own vertices, valid after upload()
+	// ------------------------------------------------------------------------
+	Mesh add(const MeshView& view)
+	{
+		Mesh mesh;
+		if (VAO != 0)
+		{
+			std::cout << "ERROR::MESH_BUFFER::ADD_AFTER_UPLOAD" << std::endl;
+			return mesh;
+		}
+		mesh.indexType = view.vertices.count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		const size_t size = indexSize(mesh.indexType);
+		indexData.resize((indexData.size() + size - 1) / size * size);
+		mesh.baseVertex = static_cast<int>(vertexData.size());
+		mesh.firstIndex = static_cast<unsigned int>(indexData.size() / size);
+		mesh.indexCount = static_cast<unsigned int>(view.indices.count);
+		vertexData.insert(vertexData.end(), view.vertices.begin(), view.vertices.end());
+		indexData.resize(indexData.size() + view.indices.count * size);
+		unsigned char* out = indexData.data() + mesh.firstIndex * size;
+		for (size_t i = 0; i < view.indices.count; i++)
+		{
+			if (mesh.indexType == GL_UNSIGNED_SHORT)
+			{
+				const uint16_t index = static_cast<uint16_t>(view.indices[i]);
+				memcpy(out + i * size, &index, size);
+			}
+			else
+			{
+				memcpy(out + i * size, &view.indices[i], size);
+			}
+		}
+		indexTotal += view.indices.count;
+		return mesh;
+	}
+	// creates the buffers and the vertex array, frees the CPU copies. Snorm16 positions need every
+	// coordinate inside [-1, 1], otherwise they fall back to half floats
+	// ------------------------------------------------------------------------
+	void upload(VertexFormat::Position format = VertexFormat::POSITION_FLOAT)
+	{
+		if (format == VertexFormat::POSITION_SNORM16)
+		{
+			for (const glm::vec3& vertex : vertexData)
+			{
+				if (glm::any(glm::greaterThan(glm::abs(vertex), glm::vec3(1.0f))))
+				{
+					std::cout << "ERROR::MESH_BUFFER::POSITION_OUT_OF_SNORM_RANGE falling back to half floats" << std::endl;
+					format = VertexFormat::POSITION_HALF;
+					break;
+				}
+			}
+		}
+		positionFormat = format;
+		layout = VertexLayout().add(0, format);
+		std::vector<unsigned char> encoded(vertexData.size() * layout.stride());
+		for (size_t v = 0; v < vertexData.size(); v++)
+			VertexFormat::encode(encoded.data() + v * layout.stride(), vertexData[v], format);
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glBindVertexArray(VAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		allocate(GL_ARRAY_BUFFER, Span<const unsigned char>(encoded.data(), encoded.size()));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		allocate(GL_ELEMENT_ARRAY_BUFFER, Span<const unsigned char>(indexData.data(), indexData.size()));
+		layout.apply();
+
+		vertexTotal = vertexData.size();
+		vertexByteTotal = encoded.size();
+		indexByteTotal = indexData.size();
+		std::vector<glm::vec3>().swap(vertexData);
+		std::vector<unsigned char>().swap(indexData);
+	}
+	// ------------------------------------------------------------------------
+	void bind() const
+	{
+		glBindVertexArray(VAO);
+	}
+	// needs bind()
+	// ------------------------------------------------------------------------
+	void draw(const Mesh& mesh) const
+	{
+		glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, mesh.indexType,
+			(void*)(mesh.firstIndex * indexSize(mesh.indexType)), mesh.baseVertex);
+	}
+	// instanceCount copies, instance attributes start at baseInstance (InstanceBuffer)
+	// ------------------------------------------------------------------------
+	void drawInstanced(const Mesh& mesh, unsigned int instanceCount, unsigned int baseInstance = 0) const
+	{
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.indexCount, mesh.indexType,
+			(void*)(mesh.firstIndex * indexSize(mesh.indexType)), instanceCount, mesh.baseVertex, baseInstance);
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		VAO = VBO = EBO = 0;
+	}
+	// ------------------------------------------------------------------------
+	size_t vertexCount() const
+	{
+		return VAO != 0 ? vertexTotal : vertexData.size();
+	}
+	size_t indexCount() const
+	{
+		return indexTotal;
+	}
+	// GPU memory, valid after upload()
+	size_t vertexBytes() const
+	{
+		return vertexByteTotal;
+	}
+	size_t indexBytes() const
+	{
+		return indexByteTotal;
+	}
+	VertexFormat::Position vertexFormat() const
+	{
+		return positionFormat;
+	}
+	// ------------------------------------------------------------------------
+	static size_t indexSize(GLenum indexType)
+	{
+		return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+private:
+	std::vector<glm::vec3> vertexData;
+	std::vector<unsigned char> indexData; // every mesh in its own indexType, aligned to it
+	size_t vertexTotal = 0;
+	size_t indexTotal = 0;
+	size_t vertexByteTotal = 0;
+	size_t indexByteTotal = 0;
+	VertexFormat::Position positionFormat = VertexFormat::POSITION_FLOAT;
+
+	// immutable storage where available (GL 4.4), the driver can place it once and forget about it
+	template<typename T>
+	static void allocate(GLenum target, Span<const T> data)
+	{
+		if (GLAD_GL_VERSION_4_4)
+			UploadCounter::bufferStorage(target, data.bytes(), data.data, 0);
+		else
+			UploadCounter::bufferData(target, data.bytes(), data.data, GL_STATIC_DRAW);
+	}
+};
+#endif
@@ -0,0 +1,515 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <glm/glm/glm.hpp>
+#include <helpers/meshview.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <vector>
+
+// Chain of simplified versions of one mesh for level of detail, levels[0] is the mesh itself.
+// Every level continues from the one before it with edge collapses in the order of their quadric
+// error (Garland and Heckbert): a vertex carries the sum of the squared distances to the planes of
+// the original triangles merged into it, a collapse moves both ends of an edge to the point where
+// that sum is smallest. Collapses that would flip a triangle or make the surface non-manifold are
+// skipped, open borders are held in place by planes through their edges.
+// The quadric sums over many planes and overstates how far the surface moved, so a level's error is
+// measured instead: the largest distance between an original vertex and the triangles now around
+// the vertex it went into, and between a new vertex and the original triangles it replaced. That is
+// in the mesh's own units, draw code turns it into pixels to pick a level (select()).
+class MeshLod
+{
+public:
+	struct Level
+	{
+		std::vector<glm::vec3> vertices;
+		std::vector<unsigned int> indices;
+		float error = 0.0f; // object space, 0 for level 0
+
+		MeshView view() const
+		{
+			return MeshView(Span<const glm::vec3>(vertices.data(), vertices.size()), Span<const unsigned int>(indices.data(), indices.size()));
+		}
+		size_t triangleCount() const { return indices.size() / 3; }
+	};
+	static const unsigned int MAX_LEVELS = 8;
+	static const size_t MIN_TRIANGLES = 8; // a level below this saves nothing worth a draw
+	std::vector<Level> levels;
+
+	// Each level aims for half the triangles of the one before. The chain ends at MAX_LEVELS,
+	// MIN_TRIANGLES, before a level whose error is above maxRelativeError times the mesh's bounding
+	// radius, or when a level would remove less than a tenth of the triangles.
+	// Touches nothing but this chain, so chains of different meshes can be built in parallel.
+	// ------------------------------------------------------------------------
+	void build(const MeshView& mesh, float maxRelativeError = 0.25f)
+	{
+		levels.assign(1, Level());
+		levels[0].vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+		levels[0].indices.assign(mesh.indices.begin(), mesh.indices.end());
+
+		glm::vec3 low(0.0f), high(0.0f);
+		for (size_t v = 0; v < mesh.vertices.count; v++)
+		{
+			low = v == 0 ? mesh.vertices[v] : glm::min(low, mesh.vertices[v]);
+			high = v == 0 ? mesh.vertices[v] : glm::max(high, mesh.vertices[v]);
+		}
+		const double maxError = maxRelativeError * 0.5 * glm::length(high - low);
+
+		Simplifier simplifier(mesh);
+		size_t triangles = mesh.triangleCount();
+		while (levels.size() < MAX_LEVELS && triangles / 2 >= MIN_TRIANGLES)
+		{
+			simplifier.collapseTo(triangles / 2);
+			if (simplifier.triangleCount() > triangles - triangles / 10)
+				break;
+			Level level;
+			simplifier.write(level);
+			level.error = std::max(level.error, levels.back().error); // select() relies on it never shrinking
+			if (level.error > maxError)
+				break;
+			triangles = simplifier.triangleCount();
+			levels.push_back(std::move(level));
+		}
+	}
+	// coarsest level whose error covers at most maxPixels, pixelsPerUnit is the screen size of one
+	// object space unit at the object's distance (projection scale over view depth)
+	// ------------------------------------------------------------------------
+	unsigned int select(float pixelsPerUnit, float maxPixels) const
+	{
+		unsigned int level = 0;
+		while (level + 1 < levels.size() && levels[level + 1].error * pixelsPerUnit <= maxPixels)
+			level++;
+		return level;
+	}
+	// ------------------------------------------------------------------------
+	static glm::dvec3 closestPoint(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+	{
+		//Voronoi regions of the corners, then the edges, then the inside (Ericson, Real-Time Collision Detection 5.1.5)
+		const glm::dvec3 ab = b - a, ac = c - a, ap = p - a, bp = p - b, cp = p - c;
+		const double d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		const double d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		const double d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d1 <= 0.0 && d2 <= 0.0)
+			return a;
+		if (d3 >= 0.0 && d4 <= d3)
+			return b;
+		if (d6 >= 0.0 && d5 <= d6)
+			return c;
+		const double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+			return a + ab * (d1 / (d1 - d3));
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+			return a + ac * (d2 / (d2 - d6));
+		if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		const double sum = va + vb + vc;
+		return sum > 0.0 ? a + ab * (vb / sum) + ac * (vc / sum) : a; // a degenerate triangle has no inside
+	}
+
+private:
+	// symmetric 4x4 matrix of the summed planes, error(p) is the sum of squared distances to them
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+
+		// n unit length, the plane is dot(n, p) + d = 0
+		void addPlane(const glm::dvec3& n, double d)
+		{
+			a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z;
+			a11 += n.y * n.y; a12 += n.y * n.z; a22 += n.z * n.z;
+			b0 += n.x * d; b1 += n.y * d; b2 += n.z * d;
+			c += d * d;
+		}
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+		}
+		double error(const glm::dvec3& p) const
+		{
+			const double e = p.x * (a00 * p.x + a01 * p.y + a02 * p.z) + p.y * (a01 * p.x + a11 * p.y + a12 * p.z)
+				+ p.z * (a02 * p.x + a12 * p.y + a22 * p.z) + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return std::max(e, 0.0);
+		}
+		// the point of least error, false where the planes don't pin one down (flat or along a crease)
+		bool minimum(glm::dvec3& p) const
+		{
+			const double c00 = a11 * a22 - a12 * a12, c01 = a02 * a12 - a01 * a22, c02 = a01 * a12 - a02 * a11;
+			const double det = a00 * c00 + a01 * c01 + a02 * c02;
+			const double scale = (a00 + a11 + a22) / 3.0;
+			if (std::fabs(det) <= 1e-6 * scale * scale * scale)
+				return false;
+			const double c11 = a00 * a22 - a02 * a02, c12 = a01 * a02 - a00 * a12, c22 = a00 * a11 - a01 * a01;
+			p.x = -(c00 * b0 + c01 * b1 + c02 * b2) / det;
+			p.y = -(c01 * b0 + c11 * b1 + c12 * b2) / det;
+			p.z = -(c02 * b0 + c12 * b1 + c22 * b2) / det;
+			return true;
+		}
+	};
+
+	// a collapse of b into a, stale once either end changed since it was queued
+	struct Collapse
+	{
+		double cost;
+		glm::dvec3 target;
+		unsigned int a, b;
+		unsigned int stampA, stampB;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const MeshView& mesh)
+		{
+			//Equal positions become one vertex, so seams between triangles that only share positions close
+			std::vector<unsigned int> order(mesh.vertices.count), weld(mesh.vertices.count);
+			for (size_t v = 0; v < order.size(); v++)
+				order[v] = static_cast<unsigned int>(v);
+			auto less = [&](unsigned int l, unsigned int r)
+			{
+				const glm::vec3& a = mesh.vertices[l];
+				const glm::vec3& b = mesh.vertices[r];
+				return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z != b.z ? a.z < b.z : l < r;
+			};
+			std::sort(order.begin(), order.end(), less);
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				if (i == 0 || mesh.vertices[order[i]] != mesh.vertices[order[i - 1]])
+					positions.push_back(glm::dvec3(mesh.vertices[order[i]]));
+				weld[order[i]] = static_cast<unsigned int>(positions.size() - 1);
+			}
+			quadrics.resize(positions.size());
+			stamps.assign(positions.size(), 0);
+			removed.assign(positions.size(), 0);
+			border.assign(positions.size(), 0);
+			vertexTriangles.resize(positions.size());
+
+			for (size_t t = 0; t < mesh.triangleCount(); t++)
+			{
+				const glm::uvec3 triangle(weld[mesh.indices[t * 3]], weld[mesh.indices[t * 3 + 1]], weld[mesh.indices[t * 3 + 2]]);
+				if (triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x)
+					continue;
+				for (int corner = 0; corner < 3; corner++)
+					vertexTriangles[triangle[corner]].push_back(static_cast<unsigned int>(triangles.size()));
+				triangles.push_back(triangle);
+			}
+			alive.assign(triangles.size(), 1);
+			live = triangles.size();
+			originalPositions = positions;
+			originalTriangles = triangles;
+			originalVertexTriangles = vertexTriangles;
+			members.resize(positions.size());
+			for (unsigned int v = 0; v < members.size(); v++)
+				members[v].push_back(v);
+
+			//Every vertex starts with the planes of its triangles, border edges add one standing on the edge
+			std::vector<Edge> edges;
+			for (unsigned int t = 0; t < triangles.size(); t++)
+			{
+				const glm::uvec3& triangle = triangles[t];
+				const glm::dvec3 normal = glm::cross(positions[triangle.y] - positions[triangle.x], positions[triangle.z] - positions[triangle.x]);
+				const double length = glm::length(normal);
+				if (length > 0.0)
+				{
+					Quadric plane;
+					plane.addPlane(normal / length, -glm::dot(normal / length, positions[triangle.x]));
+					for (int corner = 0; corner < 3; corner++)
+						quadrics[triangle[corner]].add(plane);
+				}
+				for (int corner = 0; corner < 3; corner++)
+					edges.push_back(Edge(triangle[corner], triangle[(corner + 1) % 3], t));
+			}
+			std::sort(edges.begin(), edges.end());
+			std::vector<Edge> unique;
+			for (size_t first = 0; first < edges.size();)
+			{
+				size_t end = first + 1;
+				while (end < edges.size() && edges[end].low == edges[first].low && edges[end].high == edges[first].high)
+					end++;
+				const unsigned int a = edges[first].low, b = edges[first].high;
+				unique.push_back(edges[first]);
+				if (end - first == 1)
+				{
+					const glm::uvec3& triangle = triangles[edges[first].triangle];
+					const glm::dvec3 normal = glm::cross(positions[triangle.y] - positions[triangle.x], positions[triangle.z] - positions[triangle.x]);
+					const glm::dvec3 side = glm::cross(positions[b] - positions[a], normal);
+					const double length = glm::length(side);
+					if (length > 0.0)
+					{
+						Quadric plane;
+						plane.addPlane(side / length, -glm::dot(side / length, positions[a]));
+						quadrics[a].add(plane);
+						quadrics[b].add(plane);
+					}
+					border[a] = border[b] = 1;
+				}
+				first = end;
+			}
+			for (const Edge& edge : unique)
+				queue(edge.low, edge.high);
+		}
+		// cheapest collapses first until at most target triangles are left
+		// ------------------------------------------------------------------------
+		void collapseTo(size_t target)
+		{
+			while (live > target && !candidates.empty())
+			{
+				const Collapse collapse = candidates.top();
+				candidates.pop();
+				if (removed[collapse.a] || removed[collapse.b] || stamps[collapse.a] != collapse.stampA || stamps[collapse.b] != collapse.stampB)
+					continue;
+				if (allowed(collapse.a, collapse.b, collapse.target))
+					apply(collapse);
+			}
+		}
+		// ------------------------------------------------------------------------
+		size_t triangleCount() const
+		{
+			return live;
+		}
+		// the surviving triangles in their original order, vertices in the order they are first used
+		// ------------------------------------------------------------------------
+		void write(Level& level) const
+		{
+			std::vector<unsigned int> remap(positions.size(), 0xFFFFFFFFu);
+			level.vertices.clear();
+			level.indices.clear();
+			for (size_t t = 0; t < triangles.size(); t++)
+			{
+				if (!alive[t])
+					continue;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const unsigned int vertex = triangles[t][corner];
+					if (remap[vertex] == 0xFFFFFFFFu)
+					{
+						remap[vertex] = static_cast<unsigned int>(level.vertices.size());
+						level.vertices.push_back(glm::vec3(positions[vertex]));
+					}
+					level.indices.push_back(remap[vertex]);
+				}
+			}
+			level.error = static_cast<float>(error());
+		}
+
+	private:
+		struct Edge
+		{
+			unsigned int low, high, triangle;
+
+			Edge(unsigned int a, unsigned int b, unsigned int triangle) : low(std::min(a, b)), high(std::max(a, b)), triangle(triangle) {}
+			bool operator<(const Edge& other) const
+			{
+				return low != other.low ? low < other.low : high != other.high ? high < other.high : triangle < other.triangle;
+			}
+		};
+
+		std::vector<glm::dvec3> positions;
+		std::vector<Quadric> quadrics;
+		std::vector<unsigned int> stamps; // bumped whenever a vertex moves
+		std::vector<char> removed;
+		std::vector<char> border;
+		std::vector<glm::uvec3> triangles;
+		std::vector<char> alive;
+		std::vector<std::vector<unsigned int>> vertexTriangles; // may still list dead triangles
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> candidates;
+		size_t live = 0;
+		std::vector<glm::dvec3> originalPositions; // welded, for error()
+		std::vector<glm::uvec3> originalTriangles;
+		std::vector<std::vector<unsigned int>> originalVertexTriangles;
+		std::vector<std::vector<unsigned int>> members; // original vertices merged into each vertex
+		mutable std::vector<unsigned int> aNeighbours, bNeighbours, common; // allowed(), kept to save allocations
+
+		// Both ways between the surfaces, each only against the triangles near it, so it is never less
+		// than the distance to the nearest triangle anywhere. An original vertex is tested against the
+		// triangles of its vertex and of that vertex's neighbours, the nearest one is often not its own.
+		double error() const
+		{
+			double largest = 0.0;
+			std::vector<unsigned int> ring, near;
+			for (unsigned int vertex = 0; vertex < positions.size(); vertex++)
+			{
+				if (removed[vertex])
+					continue;
+				neighbours(vertex, ring);
+				ring.push_back(vertex);
+				near.clear();
+				for (unsigned int n : ring)
+				{
+					for (unsigned int t : vertexTriangles[n])
+					{
+						if (alive[t])
+							near.push_back(t);
+					}
+				}
+				std::sort(near.begin(), near.end());
+				near.erase(std::unique(near.begin(), near.end()), near.end());
+				for (unsigned int member : members[vertex])
+				{
+					double nearest = -1.0;
+					for (unsigned int t : near)
+					{
+						const glm::uvec3& triangle = triangles[t];
+						const double distance = glm::length(originalPositions[member] - closestPoint(originalPositions[member], positions[triangle.x], positions[triangle.y], positions[triangle.z]));
+						nearest = nearest < 0.0 ? distance : std::min(nearest, distance);
+					}
+					largest = std::max(largest, nearest);
+				}
+				if (members[vertex].size() == 1 && positions[vertex] == originalPositions[vertex])
+					continue; // untouched, it lies on its own triangles
+				double nearest = -1.0;
+				for (unsigned int member : members[vertex])
+				{
+					for (unsigned int t : originalVertexTriangles[member])
+					{
+						const glm::uvec3& triangle = originalTriangles[t];
+						const double distance = glm::length(positions[vertex] - closestPoint(positions[vertex], originalPositions[triangle.x], originalPositions[triangle.y], originalPositions[triangle.z]));
+						nearest = nearest < 0.0 ? distance : std::min(nearest, distance);
+					}
+				}
+				largest = std::max(largest, nearest);
+			}
+			return largest;
+		}
+
+		// the optimal point if the planes pin one down near the edge, else the better end or the middle
+		void queue(unsigned int a, unsigned int b)
+		{
+			Quadric q = quadrics[a];
+			q.add(quadrics[b]);
+			const glm::dvec3 middle = (positions[a] + positions[b]) * 0.5;
+			Collapse collapse;
+			collapse.a = a;
+			collapse.b = b;
+			collapse.stampA = stamps[a];
+			collapse.stampB = stamps[b];
+			if (q.minimum(collapse.target) && glm::length(collapse.target - middle) <= glm::length(positions[b] - positions[a]))
+			{
+				collapse.cost = q.error(collapse.target);
+			}
+			else
+			{
+				const glm::dvec3 options[3] = { positions[a], positions[b], middle };
+				collapse.cost = -1.0;
+				for (const glm::dvec3& option : options)
+				{
+					const double cost = q.error(option);
+					if (collapse.cost < 0.0 || cost < collapse.cost)
+					{
+						collapse.cost = cost;
+						collapse.target = option;
+					}
+				}
+			}
+			candidates.push(collapse);
+		}
+		void neighbours(unsigned int vertex, std::vector<unsigned int>& result) const
+		{
+			result.clear();
+			for (unsigned int t : vertexTriangles[vertex])
+			{
+				if (!alive[t])
+					continue;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					if (triangles[t][corner] != vertex)
+						result.push_back(triangles[t][corner]);
+				}
+			}
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+		}
+		bool allowed(unsigned int a, unsigned int b, const glm::dvec3& target) const
+		{
+			//Link condition: the ends may only share the third vertices of the triangles on the edge,
+			//anything more pinches the surface into a non-manifold one
+			neighbours(a, aNeighbours);
+			neighbours(b, bNeighbours);
+			common.clear();
+			std::set_intersection(aNeighbours.begin(), aNeighbours.end(), bNeighbours.begin(), bNeighbours.end(), std::back_inserter(common));
+			size_t shared = 0;
+			for (unsigned int t : vertexTriangles[a])
+			{
+				const glm::uvec3& triangle = triangles[t];
+				shared += alive[t] && (triangle.x == b || triangle.y == b || triangle.z == b) ? 1 : 0;
+			}
+			if (common.size() != shared || shared == 0)
+				return false;
+			//An edge across the mesh between two border vertices would close the border
+			if (border[a] && border[b] && shared != 1)
+				return false;
+
+			//No triangle that stays may turn over or fold flat
+			for (unsigned int end : { a, b })
+			{
+				for (unsigned int t : vertexTriangles[end])
+				{
+					const glm::uvec3& triangle = triangles[t];
+					const bool hasA = triangle.x == a || triangle.y == a || triangle.z == a;
+					const bool hasB = triangle.x == b || triangle.y == b || triangle.z == b;
+					if (!alive[t] || (hasA && hasB))
+						continue;
+					glm::dvec3 corners[3], moved[3];
+					for (int corner = 0; corner < 3; corner++)
+					{
+						corners[corner] = positions[triangle[corner]];
+						moved[corner] = triangle[corner] == end ? target : corners[corner];
+					}
+					const glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+					const glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+					if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+						return false;
+				}
+			}
+			return true;
+		}
+		void apply(const Collapse& collapse)
+		{
+			const unsigned int a = collapse.a, b = collapse.b;
+			positions[a] = collapse.target;
+			quadrics[a].add(quadrics[b]);
+			border[a] = border[a] || border[b];
+			removed[b] = 1;
+			stamps[a]++;
+			members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+			std::vector<unsigned int>().swap(members[b]);
+
+			//Triangles on the edge go, the others of b now use a
+			for (unsigned int t : vertexTriangles[b])
+			{
+				if (!alive[t])
+					continue;
+				glm::uvec3& triangle = triangles[t];
+				if (triangle.x == a || triangle.y == a || triangle.z == a)
+				{
+					alive[t] = 0;
+					live--;
+					continue;
+				}
+				for (int corner = 0; corner < 3; corner++)
+				{
+					if (triangle[corner] == b)
+						triangle[corner] = a;
+				}
+				vertexTriangles[a].push_back(t);
+			}
+			std::vector<unsigned int>().swap(vertexTriangles[b]);
+			std::vector<unsigned int>& around = vertexTriangles[a];
+			around.erase(std::remove_if(around.begin(), around.end(), [this](unsigned int t) { return !alive[t]; }), around.end());
+
+			//Every edge of a costs something else now
+			std::vector<unsigned int> ring;
+			neighbours(a, ring);
+			for (unsigned int n : ring)
+				queue(std::min(a, n), std::max(a, n));
+		}
+	};
+};
+#endif
@@ -0,0 +1,371 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <glm/glm/glm.hpp>
+#include <helpers/meshview.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// Reorders an indexed triangle mesh for the GPU without changing what it looks like:
+// - optimizeVertexCache(): triangles in an order that reuses the vertices the post-transform cache
+//   still holds (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+// - optimizeOverdraw(): that order cut into clusters wherever the cache starts over, clusters facing
+//   away from the mesh's center first so they hide the rest from most directions (as in Tipsify,
+//   Sander et al.), clusters are only cut where it costs the cache at most threshold
+// - optimizeVertexFetch(): vertices in the order the triangles first use them, so fetches walk
+//   through memory instead of jumping around
+// analyze() measures all three, the same way on every mesh, to compare orders.
+class MeshOptimizer
+{
+public:
+	static const unsigned int CACHE_SIZE = 16; // FIFO post-transform cache analyze() simulates
+	static const unsigned int FETCH_LINE = 64; // bytes per memory fetch
+	static const unsigned int FETCH_LINES = 16; // lines the fetch cache holds
+	static const int OVERDRAW_SIZE = 256; // pixels per side of analyze()'s views
+
+	// ACMR: vertices transformed per triangle (0.5 is the best a large grid can do, 3 the worst),
+	// ATVR: per vertex of the mesh (1 is ideal), overdraw: fragments shaded per pixel covered,
+	// averaged over the six axis views, overfetch: bytes read per byte of vertices used
+	struct Stats
+	{
+		float acmr = 0.0f;
+		float atvr = 0.0f;
+		float overdraw = 0.0f;
+		float overfetch = 0.0f;
+	};
+
+	// all three passes, indices into the reordered vertices
+	// ------------------------------------------------------------------------
+	static void optimize(const MeshView& mesh, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices, float overdrawThreshold = 1.05f)
+	{
+		vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+		indices.assign(mesh.indices.begin(), mesh.indices.end());
+		optimizeVertexCache(indices, vertices.size());
+		optimizeOverdraw(indices, Span<const glm::vec3>(vertices.data(), vertices.size()), overdrawThreshold);
+		optimizeVertexFetch(indices, vertices);
+	}
+	// ------------------------------------------------------------------------
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		//Triangles of every vertex, the ones not drawn yet are kept at the front of each range
+		std::vector<unsigned int> offsets(vertexCount + 1, 0), remaining(vertexCount, 0);
+		for (unsigned int index : indices)
+			remaining[index]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + remaining[v];
+		std::vector<unsigned int> vertexTriangles(indices.size()), filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			vertexTriangles[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			vertexScores[v] = vertexScore(-1, remaining[v]);
+		std::vector<float> triangleScores(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+			triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+		std::vector<char> emitted(triangleCount, 0);
+		std::vector<unsigned int> result, cache, nextCache;
+		result.reserve(indices.size());
+		size_t scan = 0; // every triangle before it is drawn
+		long long best = -1;
+		while (result.size() < indices.size())
+		{
+			//Nothing left around the cache, the best of the rest starts a new strip
+			if (best < 0)
+			{
+				while (emitted[scan])
+					scan++;
+				best = static_cast<long long>(scan);
+				for (size_t t = scan + 1; t < triangleCount; t++)
+				{
+					if (!emitted[t] && triangleScores[t] > triangleScores[best])
+						best = static_cast<long long>(t);
+				}
+			}
+			const unsigned int triangle = static_cast<unsigned int>(best);
+			emitted[triangle] = 1;
+			nextCache.clear();
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const unsigned int vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				nextCache.push_back(vertex);
+				//Move the triangle behind the ones still to draw
+				const unsigned int first = offsets[vertex], last = first + --remaining[vertex];
+				for (unsigned int i = first; i <= last; i++)
+				{
+					if (vertexTriangles[i] == triangle)
+					{
+						std::swap(vertexTriangles[i], vertexTriangles[last]);
+						break;
+					}
+				}
+			}
+			for (unsigned int vertex : cache)
+			{
+				if (vertex != nextCache[0] && vertex != nextCache[1] && vertex != nextCache[2])
+					nextCache.push_back(vertex);
+			}
+			cache.swap(nextCache);
+
+			//Scores change only for what is or just was in the cache, the best next triangle is among theirs
+			best = -1;
+			for (size_t i = 0; i < cache.size(); i++)
+			{
+				cachePosition[cache[i]] = i < FORSYTH_CACHE ? static_cast<int>(i) : -1;
+				vertexScores[cache[i]] = vertexScore(cachePosition[cache[i]], remaining[cache[i]]);
+			}
+			for (unsigned int vertex : cache)
+			{
+				for (unsigned int i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; i++)
+				{
+					const unsigned int t = vertexTriangles[i];
+					triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+					if (best < 0 || triangleScores[t] > triangleScores[best])
+						best = t;
+				}
+			}
+			if (cache.size() > FORSYTH_CACHE)
+				cache.resize(FORSYTH_CACHE);
+		}
+		indices.swap(result);
+	}
+	// keeps the triangles of every cluster in order, only moves whole clusters
+	// ------------------------------------------------------------------------
+	static void optimizeOverdraw(std::vector<unsigned int>& indices, Span<const glm::vec3> vertices, float threshold = 1.05f)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		//Hard cuts where the cache starts over anyway (all three vertices missed), then soft cuts inside
+		//those wherever the part so far is no worse for the cache than threshold times the whole
+		std::vector<size_t> clusters;
+		std::vector<unsigned int> timestamps(vertices.count, 0);
+		unsigned int time = CACHE_SIZE + 1;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (cacheMisses(&indices[t * 3], timestamps, time) == 3 || t == 0)
+				clusters.push_back(t);
+		}
+		clusters.push_back(triangleCount);
+		std::vector<size_t> cuts;
+		for (size_t c = 0; c + 1 < clusters.size(); c++)
+		{
+			const size_t start = clusters[c], end = clusters[c + 1];
+			time += CACHE_SIZE + 1; // empty cache
+			size_t misses = 0;
+			for (size_t t = start; t < end; t++)
+				misses += cacheMisses(&indices[t * 3], timestamps, time);
+			const float limit = static_cast<float>(misses) / (end - start) * threshold;
+
+			size_t first = start, partMisses = 0;
+			time += CACHE_SIZE + 1;
+			cuts.push_back(start);
+			for (size_t t = start; t < end; t++)
+			{
+				partMisses += cacheMisses(&indices[t * 3], timestamps, time);
+				if (t + 1 < end && static_cast<float>(partMisses) <= limit * (t + 1 - first))
+				{
+					cuts.push_back(t + 1);
+					first = t + 1;
+					partMisses = 0;
+					time += CACHE_SIZE + 1;
+				}
+			}
+		}
+		cuts.push_back(triangleCount);
+
+		//Area weighted center and normal per cluster, the ones facing out from the mesh's center go first
+		glm::dvec3 meshCenter(0.0);
+		double meshArea = 0.0;
+		std::vector<glm::dvec3> centers(cuts.size() - 1, glm::dvec3(0.0)), normals(cuts.size() - 1, glm::dvec3(0.0));
+		std::vector<double> areas(cuts.size() - 1, 0.0);
+		for (size_t c = 0; c + 1 < cuts.size(); c++)
+		{
+			for (size_t t = cuts[c]; t < cuts[c + 1]; t++)
+			{
+				const glm::dvec3 a(vertices[indices[t * 3]]), b(vertices[indices[t * 3 + 1]]), d(vertices[indices[t * 3 + 2]]);
+				const glm::dvec3 normal = glm::cross(b - a, d - a);
+				const double area = glm::length(normal);
+				centers[c] += (a + b + d) * (area / 3.0);
+				normals[c] += normal;
+				areas[c] += area;
+			}
+			meshCenter += centers[c];
+			meshArea += areas[c];
+		}
+		if (meshArea <= 0.0)
+			return;
+		meshCenter /= meshArea;
+		std::vector<std::pair<double, size_t>> order(cuts.size() - 1);
+		for (size_t c = 0; c + 1 < cuts.size(); c++)
+		{
+			const glm::dvec3 center = areas[c] > 0.0 ? centers[c] / areas[c] : meshCenter;
+			const double length = glm::length(normals[c]);
+			order[c] = std::make_pair(length > 0.0 ? -glm::dot(center - meshCenter, normals[c] / length) : 0.0, c);
+		}
+		std::stable_sort(order.begin(), order.end(), [](const std::pair<double, size_t>& l, const std::pair<double, size_t>& r) { return l.first < r.first; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (const std::pair<double, size_t>& entry : order)
+			result.insert(result.end(), indices.begin() + cuts[entry.second] * 3, indices.begin() + cuts[entry.second + 1] * 3);
+		indices.swap(result);
+	}
+	// vertices nothing uses are dropped
+	// ------------------------------------------------------------------------
+	static void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<glm::vec3>& vertices)
+	{
+		std::vector<unsigned int> remap(vertices.size(), 0xFFFFFFFFu);
+		std::vector<glm::vec3> result;
+		result.reserve(vertices.size());
+		for (unsigned int& index : indices)
+		{
+			if (remap[index] == 0xFFFFFFFFu)
+			{
+				remap[index] = static_cast<unsigned int>(result.size());
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(result);
+	}
+	// ------------------------------------------------------------------------
+	static Stats analyze(const MeshView& mesh)
+	{
+		Stats stats;
+		const size_t triangleCount = mesh.triangleCount();
+		if (triangleCount == 0)
+			return stats;
+
+		//Post-transform cache and, behind it, the fetch cache the misses read through
+		std::vector<unsigned int> timestamps(mesh.vertices.count, 0), lineTimestamps(mesh.vertices.count * sizeof(glm::vec3) / FETCH_LINE + 2, 0);
+		std::vector<char> used(mesh.vertices.count, 0);
+		unsigned int time = CACHE_SIZE + 1, lineTime = FETCH_LINES + 1;
+		size_t misses = 0, usedCount = 0, fetched = 0;
+		for (unsigned int index : mesh.indices)
+		{
+			usedCount += used[index] ? 0 : 1;
+			used[index] = 1;
+			if (time - timestamps[index] <= CACHE_SIZE)
+				continue;
+			timestamps[index] = time++;
+			misses++;
+			for (size_t line = index * sizeof(glm::vec3) / FETCH_LINE; line <= ((index + 1) * sizeof(glm::vec3) - 1) / FETCH_LINE; line++)
+			{
+				if (lineTime - lineTimestamps[line] <= FETCH_LINES)
+					continue;
+				lineTimestamps[line] = lineTime++;
+				fetched += FETCH_LINE;
+			}
+		}
+		stats.acmr = static_cast<float>(misses) / triangleCount;
+		stats.atvr = static_cast<float>(misses) / usedCount;
+		stats.overfetch = static_cast<float>(fetched) / (usedCount * sizeof(glm::vec3));
+		stats.overdraw = overdraw(mesh);
+		return stats;
+	}
+
+private:
+	static const unsigned int FORSYTH_CACHE = 32; // the cache the scores assume, larger than CACHE_SIZE on purpose
+
+	// Forsyth's scores: the last triangle's vertices a bit less than the next ones in the cache (they
+	// would make strips), falling off towards the end of the cache, plus a bonus for vertices with few
+	// triangles left so none get stranded
+	static float vertexScore(int position, unsigned int remaining)
+	{
+		if (remaining == 0)
+			return -1.0f;
+		float score = 0.0f;
+		if (position >= 0 && position < 3)
+			score = 0.75f;
+		else if (position >= 3)
+			score = std::pow(1.0f - static_cast<float>(position - 3) / (FORSYTH_CACHE - 3), 1.5f);
+		return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+	}
+	// a vertex is still cached if it came in fewer than CACHE_SIZE misses ago
+	static unsigned int cacheMisses(const unsigned int* triangle, std::vector<unsigned int>& timestamps, unsigned int& time)
+	{
+		unsigned int misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (time - timestamps[triangle[corner]] > CACHE_SIZE)
+			{
+				timestamps[triangle[corner]] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	}
+	// orthographic views along both directions of every axis, depth tested in draw order, both faces
+	static float overdraw(const MeshView& mesh)
+	{
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+		for (const glm::vec3& vertex : mesh.vertices)
+		{
+			low = glm::min(low, vertex);
+			high = glm::max(high, vertex);
+		}
+		const glm::vec3 size = high - low;
+		const float scale = (OVERDRAW_SIZE - 1) / std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f));
+		std::vector<float> depth(OVERDRAW_SIZE * OVERDRAW_SIZE);
+		size_t covered = 0, shaded = 0;
+		for (int view = 0; view < 6; view++)
+		{
+			const int axis = view / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+			const float direction = view % 2 == 0 ? 1.0f : -1.0f;
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+			for (size_t t = 0; t < mesh.triangleCount(); t++)
+			{
+				glm::vec3 corners[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const glm::vec3 p = mesh.vertices[mesh.indices[t * 3 + corner]] - low;
+					corners[corner] = glm::vec3(p[u] * scale, p[v] * scale, p[axis] * direction);
+				}
+				const float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[1].y - corners[0].y) * (corners[2].x - corners[0].x);
+				if (area == 0.0f)
+					continue;
+				const int x0 = std::max(0, static_cast<int>(std::ceil(std::min(std::min(corners[0].x, corners[1].x), corners[2].x))));
+				const int x1 = std::min(OVERDRAW_SIZE - 1, static_cast<int>(std::floor(std::max(std::max(corners[0].x, corners[1].x), corners[2].x))));
+				const int y0 = std::max(0, static_cast<int>(std::ceil(std::min(std::min(corners[0].y, corners[1].y), corners[2].y))));
+				const int y1 = std::min(OVERDRAW_SIZE - 1, static_cast<int>(std::floor(std::max(std::max(corners[0].y, corners[1].y), corners[2].y))));
+				for (int y = y0; y <= y1; y++)
+				{
+					for (int x = x0; x <= x1; x++)
+					{
+						//Barycentrics from the edge functions, signed by the area so either winding is inside
+						float w[3];
+						for (int edge = 0; edge < 3; edge++)
+						{
+							const glm::vec3& a = corners[(edge + 1) % 3];
+							const glm::vec3& b = corners[(edge + 2) % 3];
+							w[edge] = ((b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x)) / area;
+						}
+						if (w[0] < 0.0f || w[1] < 0.0f || w[2] < 0.0f)
+							continue;
+						const float z = w[0] * corners[0].z + w[1] * corners[1].z + w[2] * corners[2].z;
+						float& stored = depth[y * OVERDRAW_SIZE + x];
+						if (z >= stored)
+							continue;
+						covered += stored == FLT_MAX ? 1 : 0;
+						shaded++;
+						stored = z;
+					}
+				}
+			}
+		}
+		return covered > 0 ? static_cast<float>(shaded) / covered : 0.0f;
+	}
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef MESHVIEW_H
+#define MESHVIEW_H
+
+#include <glm/glm/glm.hpp>
+
+#include <cstddef>
+
+// pointer plus element count (std::span is C++20), the count always comes from the array type
+// ------------------------------------------------------------------------
+template<typename T>
+struct Span
+{
+	T* data = nullptr;
+	size_t count = 0; // elements, never bytes
+
+	Span() {}
+	Span(T* data, size_t count) : data(data), count(count) {}
+	template<size_t N>
+	Span(T (&array)[N]) : data(array), count(N) {}
+
+	size_t bytes() const { return count * sizeof(T); }
+	bool empty() const { return count == 0; }
+	T* begin() const { return data; }
+	T* end() const { return data + count; }
+	T& operator[](size_t i) const { return data[i]; }
+};
+
+// read-only view of one indexed triangle mesh, indices relative to its own vertices
+// ------------------------------------------------------------------------
+struct MeshView
+{
+	Span<const glm::vec3> vertices;
+	Span<const unsigned int> indices;
+
+	MeshView() {}
+	MeshView(Span<const glm::vec3> vertices, Span<const unsigned int> indices) : vertices(vertices), indices(indices) {}
+	template<size_t V, size_t I>
+	MeshView(const glm::vec3 (&vertices)[V], const unsigned int (&indices)[I]) : vertices(vertices), indices(indices) {}
+
+	size_t triangleCount() const { return indices.count / 3; }
+};
+#endif
@@ -0,0 +1,157 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <atomic>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Files are named after a hash of the shader sources plus vendor, renderer and
+// version strings, so a driver update or a changed source simply misses.
+// A binary the driver rejects is reported as a miss and the caller compiles from source.
+class ProgramCache
+{
+public:
+	// empty disables the cache
+	static std::string& directory()
+	{
+		static std::string path = "shadercache";
+		return path;
+	}
+	// ------------------------------------------------------------------------
+	static bool available()
+	{
+		if (directory().empty() || !GLAD_GL_VERSION_4_1)
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+	// ------------------------------------------------------------------------
+	static std::string key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode, const std::string& computeCode = "")
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		hashString(hash, vertexCode);
+		hashString(hash, fragmentCode);
+		hashString(hash, geometryCode);
+		if (!computeCode.empty())
+			hashString(hash, computeCode); // only when set, the keys of other programs stay as they were
+		hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+		hashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+		static const char digits[] = "0123456789abcdef";
+		std::string result(16, '0');
+		for (int i = 15; i >= 0; i--, hash >>= 4)
+			result[i] = digits[hash & 0xF];
+		return result;
+	}
+	// loads the cached binary into program, false on a miss or when the driver rejects it
+	// ------------------------------------------------------------------------
+	static bool load(unsigned int program, const std::string& key)
+	{
+		std::ifstream file(path(key), std::ios::binary);
+		if (!file)
+			return false;
+
+		Header header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != MAGIC || header.length == 0)
+			return false;
+		std::vector<char> binary(header.length);
+		if (!file.read(binary.data(), binary.size()))
+			return false;
+
+		glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+			std::cout << "ERROR::PROGRAM_CACHE::BINARY_REJECTED " << key << std::endl;
+		return success != 0;
+	}
+	// program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	// ------------------------------------------------------------------------
+	static void save(unsigned int program, const std::string& key)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		Header header;
+		header.length = static_cast<unsigned int>(length);
+		std::vector<char> binary(length);
+		glGetProgramBinary(program, length, NULL, &header.format, binary.data());
+
+		// write aside under a name no other process or thread uses, then rename, a concurrent reader never sees half a file
+		std::error_code error;
+		std::filesystem::create_directories(directory(), error);
+		const std::string target = path(key);
+		const std::string temporary = target + "." + writerId() + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				std::cout << "ERROR::PROGRAM_CACHE::FILE_NOT_WRITABLE " << temporary << std::endl;
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(binary.data(), binary.size());
+			file.close();
+			if (!file)
+			{
+				std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << temporary << std::endl;
+				std::filesystem::remove(temporary, error);
+				return;
+			}
+		}
+		std::filesystem::rename(temporary, target, error);
+		if (error)
+		{
+			std::cout << "ERROR::PROGRAM_CACHE::RENAME_FAILED " << target << ": " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+		}
+	}
+
+private:
+	static const unsigned int MAGIC = 0x42505047; // "GPPB"
+
+	struct Header
+	{
+		unsigned int magic = MAGIC;
+		GLenum format = 0;
+		unsigned int length = 0;
+	};
+
+	static std::string path(const std::string& key)
+	{
+		return directory() + "/" + key + ".bin";
+	}
+	// process id and a per-process count, unique among every save() running at the same time
+	static std::string writerId()
+	{
+		static std::atomic<unsigned int> count(0);
+#ifdef _WIN32
+		const int process = _getpid();
+#else
+		const int process = static_cast<int>(getpid());
+#endif
+		return std::to_string(process) + "-" + std::to_string(count++);
+	}
+	static void hashString(unsigned long long& hash, const std::string& text)
+	{
+		for (char c : text)
+			hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		hash = (hash ^ 0xFF) * 1099511628211ull; // separator, "ab"+"c" != "a"+"bc"
+	}
+};
+#endif
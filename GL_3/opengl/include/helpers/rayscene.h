@@ -0,0 +1,196 @@
+#ifndef RAYSCENE_H
+#define RAYSCENE_H
+
+#include <glm/glm/glm.hpp>
+#include <helpers/bvh.h>
+#include <helpers/meshview.h>
+#include <helpers/jobsystem.h>
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// closest hit of RayScene::intersect(), t along the ray it was given
+// ------------------------------------------------------------------------
+struct RayHit
+{
+	float t = FLT_MAX;
+	unsigned int instance = 0xFFFFFFFFu;
+	unsigned int triangle = 0xFFFFFFFFu;
+};
+
+// Ray casts against instanced meshes (picking, visibility queries). Two levels of Bvh: one per
+// mesh over its triangles in local space, built once, and one over the world boxes of the
+// instances. A ray reaching an instance is moved into its local space instead of transforming
+// the triangles, so moving objects only need setModel() and a refit() of the top level.
+class RayScene
+{
+public:
+	// ------------------------------------------------------------------------
+	unsigned int addMesh(const MeshView& view, JobSystem* jobs = nullptr)
+	{
+		meshes.emplace_back();
+		Mesh& mesh = meshes.back();
+		mesh.view = view;
+		std::vector<BvhBox> boxes(view.triangleCount());
+		for (size_t t = 0; t < boxes.size(); t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+				boxes[t].grow(view.vertices[view.indices[t * 3 + corner]]);
+			mesh.box.grow(boxes[t]);
+		}
+		mesh.bvh.build(boxes, jobs);
+		return static_cast<unsigned int>(meshes.size() - 1);
+	}
+	// build() once all instances are in
+	// ------------------------------------------------------------------------
+	unsigned int addInstance(unsigned int mesh, const glm::mat4& model)
+	{
+		instances.emplace_back();
+		instances.back().mesh = mesh;
+		instanceBoxes.emplace_back();
+		setModel(static_cast<unsigned int>(instances.size() - 1), model);
+		return static_cast<unsigned int>(instances.size() - 1);
+	}
+	// refit() before the next ray cast
+	// ------------------------------------------------------------------------
+	void setModel(unsigned int instance, const glm::mat4& model)
+	{
+		Instance& entry = instances[instance];
+		entry.model = model;
+		entry.inverse = glm::inverse(model);
+
+		const BvhBox& local = meshes[entry.mesh].box;
+		const glm::vec3 center = glm::vec3(model * glm::vec4(local.center(), 1.0f));
+		const glm::vec3 half = (local.high - local.low) * 0.5f;
+		const glm::vec3 extent = glm::abs(glm::vec3(model[0])) * half.x + glm::abs(glm::vec3(model[1])) * half.y + glm::abs(glm::vec3(model[2])) * half.z;
+		instanceBoxes[instance].low = center - extent;
+		instanceBoxes[instance].high = center + extent;
+	}
+	// ------------------------------------------------------------------------
+	void build(JobSystem* jobs = nullptr)
+	{
+		top.build(instanceBoxes, jobs);
+	}
+	void refit()
+	{
+		top.refit(instanceBoxes);
+	}
+	// ------------------------------------------------------------------------
+	bool intersect(const Ray& ray, RayHit& hit) const
+	{
+		return trace<true>(ray, hit);
+	}
+	bool intersectScalar(const Ray& ray, RayHit& hit) const
+	{
+		return trace<false>(ray, hit);
+	}
+	// Moller-Trumbore, both sides, shortens ray.tMax when hit closer
+	// ------------------------------------------------------------------------
+	static bool intersectTriangle(Ray& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+	{
+		const glm::vec3 edge1 = v1 - v0, edge2 = v2 - v0;
+		const glm::vec3 p = glm::cross(ray.direction, edge2);
+		const float determinant = glm::dot(edge1, p);
+		if (std::fabs(determinant) < 1e-12f)
+			return false;
+		const float inverse = 1.0f / determinant;
+		const glm::vec3 s = ray.origin - v0;
+		const float u = glm::dot(s, p) * inverse;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+		const glm::vec3 q = glm::cross(s, edge1);
+		const float v = glm::dot(ray.direction, q) * inverse;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+		const float t = glm::dot(edge2, q) * inverse;
+		if (t < 0.0f || t >= ray.tMax)
+			return false;
+		ray.tMax = t;
+		return true;
+	}
+	// ------------------------------------------------------------------------
+	size_t instanceCount() const
+	{
+		return instances.size();
+	}
+	size_t triangleCount() const
+	{
+		size_t count = 0;
+		for (const Instance& instance : instances)
+			count += meshes[instance.mesh].view.triangleCount();
+		return count;
+	}
+	const glm::mat4& model(unsigned int instance) const
+	{
+		return instances[instance].model;
+	}
+	unsigned int mesh(unsigned int instance) const
+	{
+		return instances[instance].mesh;
+	}
+	const MeshView& meshView(unsigned int mesh) const
+	{
+		return meshes[mesh].view;
+	}
+
+private:
+	struct Mesh
+	{
+		MeshView view;
+		Bvh bvh;
+		BvhBox box;
+	};
+	struct Instance
+	{
+		unsigned int mesh = 0;
+		glm::mat4 model;
+		glm::mat4 inverse;
+	};
+	std::vector<Mesh> meshes;
+	std::vector<Instance> instances;
+	std::vector<BvhBox> instanceBoxes;
+	Bvh top;
+
+	// ------------------------------------------------------------------------
+	template<bool SIMD>
+	bool trace(const Ray& worldRay, RayHit& hit) const
+	{
+		Ray ray = worldRay;
+		hit = RayHit();
+		auto instanceLeaf = [&](unsigned int index, Ray& outer)
+		{
+			const Instance& instance = instances[index];
+			const Mesh& mesh = meshes[instance.mesh];
+			Ray local;
+			local.origin = glm::vec3(instance.inverse * glm::vec4(outer.origin, 1.0f));
+			local.direction = glm::vec3(instance.inverse * glm::vec4(outer.direction, 0.0f)); // unnormalized, so t stays comparable
+			local.tMax = outer.tMax;
+			unsigned int triangle = 0xFFFFFFFFu;
+			auto triangleLeaf = [&](unsigned int t, Ray& inner)
+			{
+				const glm::vec3& v0 = mesh.view.vertices[mesh.view.indices[t * 3]];
+				const glm::vec3& v1 = mesh.view.vertices[mesh.view.indices[t * 3 + 1]];
+				const glm::vec3& v2 = mesh.view.vertices[mesh.view.indices[t * 3 + 2]];
+				if (intersectTriangle(inner, v0, v1, v2))
+					triangle = t;
+			};
+			if (SIMD)
+				mesh.bvh.intersect(local, triangleLeaf);
+			else
+				mesh.bvh.intersectScalar(local, triangleLeaf);
+			if (triangle == 0xFFFFFFFFu)
+				return;
+			outer.tMax = local.tMax;
+			hit.t = local.tMax;
+			hit.instance = index;
+			hit.triangle = triangle;
+		};
+		if (SIMD)
+			top.intersect(ray, instanceLeaf);
+		else
+			top.intersectScalar(ray, instanceLeaf);
+		return hit.instance != 0xFFFFFFFFu;
+	}
+};
+#endif
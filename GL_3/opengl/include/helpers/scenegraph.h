@@ -0,0 +1,137 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/simd/matrix.h> // glm_mat4_mul, GLM_ARCH
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Transform hierarchy stored flat, in depth-first order: a parent always comes before its
+// children and every subtree is one contiguous range [node, subtreeEnd). Changing a local
+// transform only marks the node dirty, update() then walks just the ranges under dirty nodes,
+// front to back, so static nodes cost nothing and moving subtrees are updated linearly.
+// changedRanges() tells the caller which world matrices to upload after an update().
+class SceneGraph
+{
+public:
+	static constexpr unsigned int NO_PARENT = 0xFFFFFFFFu;
+	typedef std::pair<unsigned int, unsigned int> Range; // first, end
+
+	// parent has to be NO_PARENT, the last node added or one of its ancestors (depth-first order),
+	// returns NO_PARENT when it is not
+	// ------------------------------------------------------------------------
+	unsigned int add(unsigned int parent, const glm::mat4& local)
+	{
+		const unsigned int node = static_cast<unsigned int>(locals.size());
+		if (parent != NO_PARENT && (parent >= node || subtreeEnds[parent] != node))
+		{
+			std::cout << "ERROR::SCENE_GRAPH::NOT_DEPTH_FIRST node " << node << ", parent " << parent << std::endl;
+			return NO_PARENT;
+		}
+		locals.push_back(local);
+		worlds.push_back(parent == NO_PARENT ? local : worlds[parent] * local);
+		parents.push_back(parent);
+		subtreeEnds.push_back(node + 1);
+		dirty.push_back(0);
+		for (unsigned int ancestor = parent; ancestor != NO_PARENT; ancestor = parents[ancestor])
+			subtreeEnds[ancestor] = node + 1;
+		return node;
+	}
+	// ------------------------------------------------------------------------
+	void setLocal(unsigned int node, const glm::mat4& local)
+	{
+		locals[node] = local;
+		if (!dirty[node])
+		{
+			dirty[node] = 1;
+			dirtyNodes.push_back(node);
+		}
+	}
+	// recomputes the world matrices under dirty nodes, returns how many
+	// ------------------------------------------------------------------------
+	size_t update()
+	{
+		changed.clear();
+		if (dirtyNodes.empty())
+			return 0;
+		std::sort(dirtyNodes.begin(), dirtyNodes.end());
+		size_t count = 0;
+		unsigned int coveredEnd = 0; // a dirty node inside a subtree done already needs nothing more
+		for (unsigned int node : dirtyNodes)
+		{
+			dirty[node] = 0;
+			if (node < coveredEnd)
+				continue;
+			coveredEnd = subtreeEnds[node];
+			for (unsigned int i = node; i < coveredEnd; i++)
+			{
+				if (parents[i] == NO_PARENT)
+					worlds[i] = locals[i];
+				else
+					multiply(worlds[parents[i]], locals[i], worlds[i]);
+			}
+			count += coveredEnd - node;
+			if (!changed.empty() && changed.back().second == node)
+				changed.back().second = coveredEnd;
+			else
+				changed.push_back(Range(node, coveredEnd));
+		}
+		dirtyNodes.clear();
+		return count;
+	}
+	// ------------------------------------------------------------------------
+	const std::vector<Range>& changedRanges() const
+	{
+		return changed;
+	}
+	const glm::mat4& local(unsigned int node) const
+	{
+		return locals[node];
+	}
+	const glm::mat4& world(unsigned int node) const
+	{
+		return worlds[node];
+	}
+	const glm::mat4* worldData() const
+	{
+		return worlds.data();
+	}
+	unsigned int parent(unsigned int node) const
+	{
+		return parents[node];
+	}
+	size_t size() const
+	{
+		return locals.size();
+	}
+
+private:
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> subtreeEnds;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned int> dirtyNodes;
+	std::vector<Range> changed; // by the last update(), sorted, adjacent ones merged
+
+	static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+	{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		glm_vec4 left[4], right[4], result[4];
+		for (int column = 0; column < 4; column++)
+		{
+			left[column] = _mm_loadu_ps(&a[column][0]);
+			right[column] = _mm_loadu_ps(&b[column][0]);
+		}
+		glm_mat4_mul(left, right, result);
+		for (int column = 0; column < 4; column++)
+			_mm_storeu_ps(&out[column][0], result[column]);
+#else
+		out = a * b;
+#endif
+	}
+};
+#endif
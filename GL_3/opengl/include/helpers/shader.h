@@ -3,98 +3,191 @@
 
 #include <glad/glad.h>
 #include <glm/glm/glm.hpp>
+#include <helpers/uniformbuffer.h>
+#include <helpers/programcache.h>
+#include <helpers/shaderpreprocessor.h>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// uniform name hashed with FNV-1a, constexpr so that literal names hash at compile time
+// (constexpr UniformId MODEL("model");), std::string names hash at runtime without allocating
+// ------------------------------------------------------------------------
+struct UniformId
+{
+	unsigned int hash;
+
+	constexpr UniformId(const char* name) : hash(hashName(name)) {}
+	UniformId(const std::string& name) : hash(hashName(name.c_str())) {}
+
+	static constexpr unsigned int hashName(const char* name, unsigned int hash = 2166136261u)
+	{
+		return *name == '\0' ? hash : hashName(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u);
+	}
+};
+
+// pre-resolved location of a uniform of type T, get it once through Shader::uniform<T>()
+// ------------------------------------------------------------------------
+template<typename T>
+struct Uniform
+{
+	int location = -1;
+
+	bool valid() const { return location >= 0; }
+};
+
+// GL type reported by glGetActiveUniform for each handle type
+template<typename T> struct UniformType;
+template<> struct UniformType<bool> { static const GLenum value = GL_BOOL; };
+template<> struct UniformType<int> { static const GLenum value = GL_INT; };
+template<> struct UniformType<float> { static const GLenum value = GL_FLOAT; };
+template<> struct UniformType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template<> struct UniformType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template<> struct UniformType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template<> struct UniformType<glm::mat2> { static const GLenum value = GL_FLOAT_MAT2; };
+template<> struct UniformType<glm::mat3> { static const GLenum value = GL_FLOAT_MAT3; };
+template<> struct UniformType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
 class Shader
 {
 public:
-	unsigned int ID;
+	unsigned int ID = 0;
+	// active uniforms, filled once after linking
+	struct UniformSlot
+	{
+		unsigned int hash = 0;
+		int location = -1; // -1 marks an empty slot
+		GLenum type = 0;
+		int size = 0; // array length
+	};
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
 	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
 	{
-		// 1. retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream gShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
+		ShaderSources sources;
+		readSources(vertexPath, fragmentPath, geometryPath, sources);
+		beginBuild(sources);
+		endBuild();
+	}
+	// from already preprocessed sources (ShaderPreprocessor, ShaderVariants)
+	// ------------------------------------------------------------------------
+	Shader(const ShaderSources& sources)
+	{
+		beginBuild(sources);
+		endBuild();
+	}
+	// no program yet, built later through beginBuild()/endBuild() (ShaderBatch)
+	// ------------------------------------------------------------------------
+	Shader()
+	{
+	}
+	// replaces the program with one built from new sources, keeps the old one if that fails.
+	// uniform locations may move, handles have to be resolved again afterwards
+	// ------------------------------------------------------------------------
+	bool rebuild(const ShaderSources& sources)
+	{
+		beginBuild(sources);
+		return endBuild();
+	}
+	// issues compile and link and returns, with KHR_parallel_shader_compile the driver works
+	// on them in the background until endBuild() asks for the result
+	// ------------------------------------------------------------------------
+	void beginBuild(const ShaderSources& sources)
+	{
+		discardBuild();
+		pending.active = true;
+		pending.program = glCreateProgram();
+		// 1. reuse the linked binary of an earlier run if the driver accepts it
+		pending.cached = ProgramCache::available();
+		if (pending.cached)
 		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-			// if geometry shader path is present, also load a geometry shader
-			if (geometryPath != nullptr)
+			pending.cacheKey = ProgramCache::key(sources.vertex, sources.fragment, sources.geometry, sources.compute);
+			if (ProgramCache::load(pending.program, pending.cacheKey))
 			{
-				gShaderFile.open(geometryPath);
-				std::stringstream gShaderStream;
-				gShaderStream << gShaderFile.rdbuf();
-				gShaderFile.close();
-				geometryCode = gShaderStream.str();
+				pending.fromCache = true;
+				return;
 			}
+			glDeleteProgram(pending.program); // a rejected binary leaves the program unusable
+			pending.program = glCreateProgram();
 		}
-		catch (std::ifstream::failure e)
+		// 2. compile shaders, errors are only checked in endBuild so the calls don't wait for the compiler
+		if (!sources.compute.empty())
 		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			pending.shaders[3] = compileStage(GL_COMPUTE_SHADER, sources.compute);
 		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
-		// if geometry shader is given, compile geometry shader
-		unsigned int geometry;
-		if (geometryPath != nullptr)
+		else
 		{
-			const char * gShaderCode = geometryCode.c_str();
-			geometry = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometry, 1, &gShaderCode, NULL);
-			glCompileShader(geometry);
-			checkCompileErrors(geometry, "GEOMETRY");
+			pending.shaders[0] = compileStage(GL_VERTEX_SHADER, sources.vertex);
+			pending.shaders[1] = compileStage(GL_FRAGMENT_SHADER, sources.fragment);
+			// if geometry shader is given, compile geometry shader
+			if (!sources.geometry.empty())
+				pending.shaders[2] = compileStage(GL_GEOMETRY_SHADER, sources.geometry);
 		}
 		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		if (geometryPath != nullptr)
-			glAttachShader(ID, geometry);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
-		// delete the shaders as they're linked into our program now and no longer necessery
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-		if (geometryPath != nullptr)
-			glDeleteShader(geometry);
-
+		for (unsigned int stage : pending.shaders)
+		{
+			if (stage != 0)
+				glAttachShader(pending.program, stage);
+		}
+		if (pending.cached)
+			glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(pending.program);
+	}
+	// never blocks, always true without KHR_parallel_shader_compile (endBuild waits then)
+	// ------------------------------------------------------------------------
+	bool buildReady() const
+	{
+		if (!pending.active || pending.fromCache || !(GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile))
+			return true;
+		GLint done = GL_TRUE;
+		glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+	// swaps the new program in, or keeps the current one when the build failed
+	// ------------------------------------------------------------------------
+	bool endBuild()
+	{
+		if (!pending.active)
+			return false;
+		bool linked = pending.fromCache;
+		if (!linked)
+		{
+			const char* names[4] = { "VERTEX", "FRAGMENT", "GEOMETRY", "COMPUTE" };
+			for (int i = 0; i < 4; i++)
+			{
+				if (pending.shaders[i] != 0)
+					checkCompileErrors(pending.shaders[i], names[i]);
+			}
+			linked = checkCompileErrors(pending.program, "PROGRAM");
+			if (linked && pending.cached)
+				ProgramCache::save(pending.program, pending.cacheKey);
+		}
+		if (linked)
+		{
+			glDeleteProgram(ID);
+			ID = pending.program;
+			pending.program = 0;
+			reflectUniforms();
+			bindUniformBlocks();
+		}
+		discardBuild();
+		return linked;
+	}
+	// retrieve the vertex/fragment/geometry source code from filePath with includes expanded,
+	// no GL calls (safe on any thread)
+	// ------------------------------------------------------------------------
+	static bool readSources(const char* vertexPath, const char* fragmentPath, const char* geometryPath, ShaderSources& sources)
+	{
+		std::vector<std::string> files;
+		return ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath != nullptr ? geometryPath : "", ShaderDefines(), sources, files);
+	}
+	static bool readCompute(const char* computePath, ShaderSources& sources)
+	{
+		std::vector<std::string> files;
+		return ShaderPreprocessor::loadCompute(computePath, ShaderDefines(), sources, files);
 	}
 	// activate the shader
 	// ------------------------------------------------------------------------
@@ -102,69 +195,223 @@ public:
 	{
 		glUseProgram(ID);
 	}
-	// utility uniform functions
+	// reflected uniforms
 	// ------------------------------------------------------------------------
-	void setBool(const std::string &name, bool value) const
+	const UniformSlot* findUniform(UniformId id) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		if (uniforms.empty())
+			return nullptr;
+		const size_t mask = uniforms.size() - 1;
+		for (size_t i = id.hash & mask;; i = (i + 1) & mask)
+		{
+			const UniformSlot& slot = uniforms[i];
+			if (slot.location < 0)
+				return nullptr;
+			if (slot.hash == id.hash)
+				return &slot;
+		}
+	}
+	int location(UniformId id) const
+	{
+		const UniformSlot* slot = findUniform(id);
+		return slot != nullptr ? slot->location : -1;
+	}
+	// typed handle for the hot path, unknown names give an invalid handle (writes to -1 are ignored by GL)
+	template<typename T>
+	Uniform<T> uniform(UniformId id) const
+	{
+		Uniform<T> handle;
+		const UniformSlot* slot = findUniform(id);
+		if (slot == nullptr)
+			return handle;
+		if (!typeMatches(UniformType<T>::value, slot->type))
+			std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH location: " << slot->location << std::endl;
+		handle.location = slot->location;
+		return handle;
 	}
 	// ------------------------------------------------------------------------
-	void setInt(const std::string &name, int value) const
+	void set(Uniform<bool> uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+	void set(Uniform<int> uniform, int value) const { glUniform1i(uniform.location, value); }
+	void set(Uniform<float> uniform, float value) const { glUniform1f(uniform.location, value); }
+	void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const { glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+	void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+	void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+	// utility uniform functions (table lookup, no driver query)
+	// ------------------------------------------------------------------------
+	void setBool(UniformId name, bool value) const
+	{
+		glUniform1i(location(name), (int)value);
+	}
+	// ------------------------------------------------------------------------
+	void setInt(UniformId name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(location(name), value);
 	}
 	// ------------------------------------------------------------------------
-	void setFloat(const std::string &name, float value) const
+	void setFloat(UniformId name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(location(name), value);
 	}
 	// ------------------------------------------------------------------------
-	void setVec2(const std::string &name, const glm::vec2 &value) const
+	void setVec2(UniformId name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(location(name), 1, &value[0]);
 	}
-	void setVec2(const std::string &name, float x, float y) const
+	void setVec2(UniformId name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(location(name), x, y);
 	}
 	// ------------------------------------------------------------------------
-	void setVec3(const std::string &name, const glm::vec3 &value) const
+	void setVec3(UniformId name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(location(name), 1, &value[0]);
 	}
-	void setVec3(const std::string &name, float x, float y, float z) const
+	void setVec3(UniformId name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(location(name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
-	void setVec4(const std::string &name, const glm::vec4 &value) const
+	void setVec4(UniformId name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(location(name), 1, &value[0]);
 	}
-	void setVec4(const std::string &name, float x, float y, float z, float w)
+	void setVec4(UniformId name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(location(name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
-	void setMat2(const std::string &name, const glm::mat2 &mat) const
+	void setMat2(UniformId name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
-	void setMat3(const std::string &name, const glm::mat3 &mat) const
+	void setMat3(UniformId name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
-	void setMat4(const std::string &name, const glm::mat4 &mat) const
+	void setMat4(UniformId name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
 private:
+	std::vector<UniformSlot> uniforms; // open addressing on the name hash, power of two size
+
+	// state between beginBuild() and endBuild()
+	struct PendingBuild
+	{
+		bool active = false;
+		bool cached = false;
+		bool fromCache = false;
+		std::string cacheKey;
+		unsigned int program = 0;
+		unsigned int shaders[4] = {}; // vertex, fragment, geometry, compute
+	};
+	PendingBuild pending;
+
+	// ------------------------------------------------------------------------
+	static unsigned int compileStage(GLenum type, const std::string& source)
+	{
+		const char* code = source.c_str();
+		const unsigned int stage = glCreateShader(type);
+		glShaderSource(stage, 1, &code, NULL);
+		glCompileShader(stage);
+		return stage;
+	}
+	// delete the shaders as they're linked into our program now and no longer necessery
+	// ------------------------------------------------------------------------
+	void discardBuild()
+	{
+		for (unsigned int& stage : pending.shaders)
+		{
+			glDeleteShader(stage);
+			stage = 0;
+		}
+		glDeleteProgram(pending.program);
+		pending = PendingBuild();
+	}
+
+	// enumerates the active uniforms once, the only place that talks to the driver about names
+	// ------------------------------------------------------------------------
+	void reflectUniforms()
+	{
+		GLint count = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		size_t capacity = 1;
+		while (capacity < static_cast<size_t>(count) * 2)
+			capacity <<= 1;
+		uniforms.assign(capacity, UniformSlot());
+
+		std::vector<GLchar> buffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, i, maxLength + 1, &length, &size, &type, buffer.data());
+			std::string name(buffer.data(), length);
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				name.resize(name.size() - 3);
+
+			const int location = glGetUniformLocation(ID, name.c_str());
+			if (location < 0)
+				continue; // uniform block member
+
+			const unsigned int hash = UniformId(name).hash;
+			size_t index = hash & (capacity - 1);
+			while (uniforms[index].location >= 0)
+			{
+				if (uniforms[index].hash == hash)
+					std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << name << std::endl;
+				index = (index + 1) & (capacity - 1);
+			}
+			uniforms[index].hash = hash;
+			uniforms[index].location = location;
+			uniforms[index].type = type;
+			uniforms[index].size = size;
+		}
+	}
+	// attaches the shared blocks (UniformBlocks) this program uses to their binding points
+	// ------------------------------------------------------------------------
+	void bindUniformBlocks()
+	{
+		for (const UniformBlocks::Entry& entry : UniformBlocks::entries)
+		{
+			const GLuint index = glGetUniformBlockIndex(ID, entry.name);
+			if (index != GL_INVALID_INDEX)
+				glUniformBlockBinding(ID, index, entry.binding);
+		}
+	}
+	// ints also drive bools and samplers
+	// ------------------------------------------------------------------------
+	static bool typeMatches(GLenum expected, GLenum actual)
+	{
+		if (expected == actual)
+			return true;
+		if (expected == GL_INT || expected == GL_BOOL)
+		{
+			switch (actual)
+			{
+			case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+			case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+				return false;
+			default:
+				return true;
+			}
+		}
+		return false;
+	}
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	bool checkCompileErrors(GLuint shader, std::string type)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -186,6 +433,7 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success != 0;
 	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#ifndef SHADERBATCH_H
+#define SHADERBATCH_H
+
+#include <helpers/shader.h>
+#include <helpers/shaderpreprocessor.h>
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Builds many programs at once.
+// add() reads and preprocesses files on worker threads, submit() hands every program to the
+// driver without waiting for the compiler, poll() finishes the ones that are done. With
+// KHR_parallel_shader_compile the driver compiles them on its own threads meanwhile, without it
+// the compiles run one after the other inside poll().
+class ShaderBatch
+{
+public:
+	// ------------------------------------------------------------------------
+	void add(Shader& shader, const std::string& vertexPath, const std::string& fragmentPath,
+		const std::string& geometryPath = "", const ShaderDefines& defines = ShaderDefines())
+	{
+		Job job;
+		job.shader = &shader;
+		job.prepared = std::async(std::launch::async, [vertexPath, fragmentPath, geometryPath, defines]()
+		{
+			Prepared prepared;
+			std::vector<std::string> files;
+			prepared.loaded = ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath, defines, prepared.sources, files);
+			return prepared;
+		});
+		jobs.push_back(std::move(job));
+	}
+	// already preprocessed sources
+	// ------------------------------------------------------------------------
+	void add(Shader& shader, const ShaderSources& sources)
+	{
+		std::promise<Prepared> ready;
+		Prepared prepared;
+		prepared.loaded = true;
+		prepared.sources = sources;
+		ready.set_value(prepared);
+
+		Job job;
+		job.shader = &shader;
+		job.prepared = ready.get_future();
+		jobs.push_back(std::move(job));
+	}
+	// waits for the file workers, not for the compiler
+	// ------------------------------------------------------------------------
+	void submit()
+	{
+		enableParallelCompile();
+		for (Job& job : jobs)
+		{
+			if (job.state != Job::QUEUED)
+				continue;
+			const Prepared prepared = job.prepared.get();
+			if (!prepared.loaded)
+			{
+				job.state = Job::FAILED;
+				continue;
+			}
+			job.shader->beginBuild(prepared.sources);
+			job.state = Job::BUILDING;
+		}
+	}
+	// never blocks with KHR_parallel_shader_compile, true once every program is finished
+	// ------------------------------------------------------------------------
+	bool poll()
+	{
+		bool finished = true;
+		for (Job& job : jobs)
+		{
+			if (job.state == Job::QUEUED)
+				finished = false;
+			if (job.state != Job::BUILDING)
+				continue;
+			if (!job.shader->buildReady())
+			{
+				finished = false;
+				continue;
+			}
+			job.state = job.shader->endBuild() ? Job::DONE : Job::FAILED;
+		}
+		return finished;
+	}
+	// ------------------------------------------------------------------------
+	void wait()
+	{
+		submit();
+		while (!poll())
+			std::this_thread::yield();
+	}
+	// programs that could not be read or built, they keep their previous ID
+	// ------------------------------------------------------------------------
+	size_t failed() const
+	{
+		size_t count = 0;
+		for (const Job& job : jobs)
+			count += job.state == Job::FAILED ? 1 : 0;
+		return count;
+	}
+	// ------------------------------------------------------------------------
+	size_t size() const
+	{
+		return jobs.size();
+	}
+	// let the driver use as many compiler threads as it likes, once per context
+	// ------------------------------------------------------------------------
+	static void enableParallelCompile()
+	{
+		static bool enabled = false;
+		if (enabled)
+			return;
+		enabled = true;
+		if (GLAD_GL_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else if (GLAD_GL_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+
+private:
+	struct Prepared
+	{
+		bool loaded = false;
+		ShaderSources sources;
+	};
+	struct Job
+	{
+		enum State { QUEUED, BUILDING, DONE, FAILED };
+		Shader* shader = nullptr;
+		std::future<Prepared> prepared;
+		State state = QUEUED;
+	};
+	std::vector<Job> jobs;
+};
+#endif
@@ -0,0 +1,211 @@
+#ifndef SHADERPREPROCESSOR_H
+#define SHADERPREPROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+// source code of all stages, geometry may be empty, compute is only set for compute programs (alone)
+struct ShaderSources
+{
+	std::string vertex;
+	std::string fragment;
+	std::string geometry;
+	std::string compute;
+};
+
+// name/value pairs injected as "#define name value" right after #version
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// Expands shader files before they reach the compiler, no GL calls (safe on any thread).
+// - #include "file" is resolved relative to the including file, every file is included once
+// - #line directives keep compiler messages pointing at the right file and line, the source
+//   string number of a message is the index of the file in the files list
+// - only the defines a stage actually mentions are injected, sorted by name, so variants that
+//   differ in defines a stage ignores produce the same text (and hash) for that stage
+class ShaderPreprocessor
+{
+public:
+	// ------------------------------------------------------------------------
+	static bool process(const std::string& path, const ShaderDefines& defines, std::string& source, std::vector<std::string>& files)
+	{
+		std::string expanded;
+		const size_t first = files.size();
+		if (!expand(path, expanded, files, first))
+			return false;
+		source = inject(expanded, defines);
+		return true;
+	}
+	// geometryPath may be empty, files receives every file read (vertex, fragment, geometry, includes)
+	// ------------------------------------------------------------------------
+	static bool load(const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath,
+		const ShaderDefines& defines, ShaderSources& sources, std::vector<std::string>& files)
+	{
+		files.clear();
+		// every stage numbers its own files, includes shared by two stages are expanded in both
+		std::vector<std::string> stageFiles;
+		if (!process(vertexPath, defines, sources.vertex, stageFiles))
+			return false;
+		files.insert(files.end(), stageFiles.begin(), stageFiles.end());
+		stageFiles.clear();
+		if (!process(fragmentPath, defines, sources.fragment, stageFiles))
+			return false;
+		files.insert(files.end(), stageFiles.begin(), stageFiles.end());
+		stageFiles.clear();
+		sources.geometry.clear();
+		if (!geometryPath.empty())
+		{
+			if (!process(geometryPath, defines, sources.geometry, stageFiles))
+				return false;
+			files.insert(files.end(), stageFiles.begin(), stageFiles.end());
+		}
+		return true;
+	}
+	// a compute program, the one stage it has
+	// ------------------------------------------------------------------------
+	static bool loadCompute(const std::string& computePath, const ShaderDefines& defines, ShaderSources& sources, std::vector<std::string>& files)
+	{
+		files.clear();
+		sources = ShaderSources();
+		return process(computePath, defines, sources.compute, files);
+	}
+	// FNV-1a over the preprocessed stages, equal hashes mean the same program
+	// ------------------------------------------------------------------------
+	static unsigned long long hash(const ShaderSources& sources)
+	{
+		unsigned long long result = 14695981039346656037ull;
+		for (const std::string* stage : { &sources.vertex, &sources.fragment, &sources.geometry, &sources.compute })
+		{
+			for (char c : *stage)
+				result = (result ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+			result = (result ^ 0xFF) * 1099511628211ull; // stage separator
+		}
+		return result;
+	}
+
+private:
+	static const unsigned int MAX_DEPTH = 32;
+
+	// appends path with its includes to output, file numbers start at first
+	static bool expand(const std::string& path, std::string& output, std::vector<std::string>& files, size_t first, unsigned int depth = 0)
+	{
+		const std::string normalized = std::filesystem::path(path).lexically_normal().generic_string();
+		const unsigned int fileIndex = static_cast<unsigned int>(files.size() - first);
+		files.push_back(normalized);
+
+		std::ifstream file(normalized);
+		if (!file)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << normalized << std::endl;
+			return false;
+		}
+		const std::filesystem::path directory = std::filesystem::path(normalized).parent_path();
+
+		std::string line;
+		unsigned int lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			std::string include;
+			if (!parseInclude(line, include))
+			{
+				output += line;
+				output += '\n';
+				continue;
+			}
+			if (include.empty())
+			{
+				std::cout << "ERROR::SHADER_PREPROCESSOR::BAD_INCLUDE " << normalized << ":" << lineNumber << std::endl;
+				return false;
+			}
+			if (depth + 1 >= MAX_DEPTH)
+			{
+				std::cout << "ERROR::SHADER_PREPROCESSOR::INCLUDE_TOO_DEEP " << normalized << ":" << lineNumber << std::endl;
+				return false;
+			}
+			const std::string target = (directory / include).lexically_normal().generic_string();
+			if (std::find(files.begin() + first, files.end(), target) == files.end())
+			{
+				output += "#line 1 " + std::to_string(files.size() - first) + "\n";
+				if (!expand(target, output, files, first, depth + 1))
+				{
+					std::cout << "  included from " << normalized << ":" << lineNumber << std::endl;
+					return false;
+				}
+			}
+			output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+		}
+		return true;
+	}
+	// true for an #include line, include is left empty when the name can't be read
+	static bool parseInclude(const std::string& line, std::string& include)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#')
+			return false;
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+			return false;
+		i = line.find_first_not_of(" \t", i + 7);
+		if (i == std::string::npos || (line[i] != '"' && line[i] != '<'))
+			return true;
+		const size_t end = line.find(line[i] == '"' ? '"' : '>', i + 1);
+		if (end != std::string::npos)
+			include = line.substr(i + 1, end - i - 1);
+		return true;
+	}
+	// defines go after #version, which has to stay the first statement
+	static std::string inject(const std::string& source, const ShaderDefines& defines)
+	{
+		ShaderDefines used;
+		for (const auto& define : defines)
+		{
+			if (mentions(source, define.first))
+				used.push_back(define);
+		}
+		if (used.empty())
+			return source;
+		std::sort(used.begin(), used.end());
+
+		size_t insert = 0;
+		unsigned int nextLine = 1;
+		const size_t version = source.find("#version");
+		if (version != std::string::npos)
+		{
+			const size_t end = source.find('\n', version);
+			insert = end == std::string::npos ? source.size() : end + 1;
+			nextLine = static_cast<unsigned int>(std::count(source.begin(), source.begin() + insert, '\n')) + 1;
+		}
+		std::string block;
+		for (const auto& define : used)
+			block += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+		block += "#line " + std::to_string(nextLine) + " 0\n";
+
+		std::string result = source.substr(0, insert);
+		if (insert > 0 && result.back() != '\n')
+			result += '\n';
+		return result + block + source.substr(insert);
+	}
+	// whole identifier match, comments count as well (never merges variants that differ)
+	static bool mentions(const std::string& source, const std::string& name)
+	{
+		if (name.empty())
+			return false;
+		for (size_t i = source.find(name); i != std::string::npos; i = source.find(name, i + 1))
+		{
+			const size_t end = i + name.size();
+			if ((i == 0 || !isIdentifier(source[i - 1])) && (end >= source.size() || !isIdentifier(source[end])))
+				return true;
+		}
+		return false;
+	}
+	static bool isIdentifier(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+};
+#endif
@@ -0,0 +1,150 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <helpers/shader.h>
+#include <helpers/shaderbatch.h>
+#include <helpers/shaderwatcher.h>
+#include <helpers/shaderpreprocessor.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+
+// Named permutations of one set of shader files, e.g. "default" and "wireframe" of vert.vs + frag.fs
+// with different defines. Every variant is preprocessed and hashed, variants with the same
+// preprocessed sources share one compiled program, so a define no stage mentions costs nothing.
+// Programs are compiled together through compile(), which lets the driver build them in parallel.
+class ShaderVariants
+{
+public:
+	// preprocesses and, if no equal variant exists yet, queues a new program for compile().
+	// the returned shader has no program before that, nullptr if the files can't be read
+	// ------------------------------------------------------------------------
+	Shader* add(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath,
+		const ShaderDefines& defines = ShaderDefines(), const std::string& geometryPath = "")
+	{
+		Variant variant;
+		variant.name = name;
+		variant.vertexPath = vertexPath;
+		variant.fragmentPath = fragmentPath;
+		variant.geometryPath = geometryPath;
+		variant.defines = defines;
+
+		ShaderSources sources;
+		std::vector<std::string> files;
+		if (!ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath, defines, sources, files))
+		{
+			std::cout << "ERROR::SHADER_VARIANTS::NOT_LOADED " << name << std::endl;
+			return nullptr;
+		}
+		const unsigned long long hash = ShaderPreprocessor::hash(sources);
+		const auto existing = programsByHash.find(hash);
+		if (existing != programsByHash.end())
+		{
+			variant.program = existing->second;
+		}
+		else
+		{
+			variant.program = programs.size();
+			Program program;
+			program.hash = hash;
+			program.shader.reset(new Shader());
+			program.sources = sources;
+			programs.push_back(std::move(program));
+			programsByHash[hash] = variant.program;
+		}
+		programs[variant.program].variants.push_back(variants.size());
+		variants.push_back(variant);
+		return programs[variant.program].shader.get();
+	}
+	// adds every program not compiled yet, the batch finishes them
+	// ------------------------------------------------------------------------
+	void compile(ShaderBatch& batch)
+	{
+		for (Program& program : programs)
+		{
+			if (program.queued)
+				continue;
+			batch.add(*program.shader, program.sources);
+			program.sources = ShaderSources();
+			program.queued = true;
+		}
+	}
+	// ------------------------------------------------------------------------
+	Shader* find(const std::string& name) const
+	{
+		for (const Variant& variant : variants)
+		{
+			if (variant.name == name)
+				return programs[variant.program].shader.get();
+		}
+		return nullptr;
+	}
+	// ------------------------------------------------------------------------
+	size_t variantCount() const
+	{
+		return variants.size();
+	}
+	size_t programCount() const
+	{
+		return programs.size();
+	}
+	// registers every program, the worker preprocesses with the defines of the program's first variant
+	// ------------------------------------------------------------------------
+	void watch(ShaderWatcher& watcher, ShaderWatcher::ReloadCallback onReload = nullptr)
+	{
+		for (const Program& program : programs)
+		{
+			std::vector<Variant> members;
+			std::string name;
+			for (size_t index : program.variants)
+			{
+				members.push_back(variants[index]);
+				name += (name.empty() ? "" : "/") + variants[index].name;
+			}
+			watcher.watch(*program.shader, name, [members](ShaderSources& sources, std::vector<std::string>& files)
+			{
+				const Variant& first = members[0];
+				if (!ShaderPreprocessor::load(first.vertexPath, first.fragmentPath, first.geometryPath, first.defines, sources, files))
+					return false;
+				// merged variants stay merged until restart, say so when an edit made them differ
+				const unsigned long long hash = ShaderPreprocessor::hash(sources);
+				for (size_t i = 1; i < members.size(); i++)
+				{
+					ShaderSources other;
+					std::vector<std::string> otherFiles;
+					if (ShaderPreprocessor::load(members[i].vertexPath, members[i].fragmentPath, members[i].geometryPath, members[i].defines, other, otherFiles)
+						&& ShaderPreprocessor::hash(other) != hash)
+						std::cout << "ERROR::SHADER_VARIANTS::VARIANTS_DIVERGED restart to split " << first.name << " and " << members[i].name << std::endl;
+				}
+				return true;
+			}, onReload);
+		}
+	}
+
+private:
+	struct Variant
+	{
+		std::string name;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::string geometryPath;
+		ShaderDefines defines;
+		size_t program = 0;
+	};
+	struct Program
+	{
+		unsigned long long hash = 0;
+		std::unique_ptr<Shader> shader; // stable address for the watcher and callers
+		std::vector<size_t> variants;
+		ShaderSources sources; // until compile()
+		bool queued = false;
+	};
+
+	std::vector<Variant> variants;
+	std::vector<Program> programs;
+	std::unordered_map<unsigned long long, size_t> programsByHash;
+};
+#endif
@@ -0,0 +1,311 @@
+#ifndef SHADERWATCHER_H
+#define SHADERWATCHER_H
+
+#include <helpers/shader.h>
+#include <helpers/shaderbatch.h>
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// Reloads shaders while the program runs.
+// A worker thread waits for changes to the source files (inotify on Linux, modification
+// time polling elsewhere) and reads and preprocesses the new sources. apply() runs once per
+// frame on the GL thread, never waits for the worker and starts the compile. With
+// KHR_parallel_shader_compile the program is swapped in on a later frame once the driver is done.
+// A program that fails to build is dropped and the previous one keeps running.
+class ShaderWatcher
+{
+public:
+	// called on the GL thread after a successful swap, re-resolve uniform handles here
+	typedef std::function<void(Shader&)> ReloadCallback;
+	// called on the worker, fills the sources and every file they were read from (includes too)
+	typedef std::function<bool(ShaderSources&, std::vector<std::string>&)> SourceLoader;
+
+	~ShaderWatcher()
+	{
+		stop();
+	}
+	// register before start()
+	// ------------------------------------------------------------------------
+	void watch(Shader& shader, const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath = "", ReloadCallback onReload = nullptr)
+	{
+		watch(shader, vertexPath + ", " + fragmentPath, [vertexPath, fragmentPath, geometryPath](ShaderSources& sources, std::vector<std::string>& files)
+		{
+			return ShaderPreprocessor::load(vertexPath, fragmentPath, geometryPath, ShaderDefines(), sources, files);
+		}, onReload);
+	}
+	// sources produced by any loader, e.g. with defines (ShaderVariants)
+	// ------------------------------------------------------------------------
+	void watch(Shader& shader, const std::string& name, SourceLoader load, ReloadCallback onReload = nullptr)
+	{
+		Entry entry;
+		entry.shader = &shader;
+		entry.name = name;
+		entry.load = load;
+		entry.onReload = onReload;
+		entries.push_back(entry);
+	}
+	// ------------------------------------------------------------------------
+	void start()
+	{
+		if (running.exchange(true))
+			return;
+		worker = std::thread(&ShaderWatcher::run, this);
+	}
+	// ------------------------------------------------------------------------
+	void stop()
+	{
+		if (!running.exchange(false))
+			return;
+		worker.join();
+	}
+	// GL thread, at a frame boundary
+	// ------------------------------------------------------------------------
+	void apply()
+	{
+		// finish the builds the driver completed since the last frame
+		for (size_t i = 0; i < building.size();)
+		{
+			Entry& entry = entries[building[i]];
+			if (!entry.shader->buildReady())
+			{
+				i++;
+				continue;
+			}
+			building.erase(building.begin() + i);
+			if (!entry.shader->endBuild())
+			{
+				std::cout << "ERROR::SHADER_WATCHER::RELOAD_FAILED keeping previous program: " << entry.name << std::endl;
+				continue;
+			}
+			std::cout << "Reloaded shader: " << entry.name << std::endl;
+			if (entry.onReload)
+				entry.onReload(*entry.shader);
+		}
+
+		if (!hasPending.load(std::memory_order_acquire))
+			return;
+		std::vector<Pending> ready;
+		{
+			std::unique_lock<std::mutex> lock(pendingMutex, std::try_to_lock);
+			if (!lock.owns_lock())
+				return; // worker is publishing, pick it up next frame
+			ready.swap(pending);
+			hasPending.store(false, std::memory_order_relaxed);
+		}
+		ShaderBatch::enableParallelCompile();
+		for (const Pending& reload : ready)
+		{
+			// a newer edit replaces a build still in flight
+			entries[reload.entry].shader->beginBuild(reload.sources);
+			if (std::find(building.begin(), building.end(), reload.entry) == building.end())
+				building.push_back(reload.entry);
+		}
+	}
+
+private:
+	struct Entry
+	{
+		Shader* shader = nullptr;
+		std::string name;
+		SourceLoader load;
+		ReloadCallback onReload;
+		std::vector<std::filesystem::path> files; // worker only, refreshed on every load
+	};
+	struct Pending
+	{
+		size_t entry;
+		ShaderSources sources;
+	};
+
+	std::vector<Entry> entries; // fixed once the worker runs
+	std::vector<Pending> pending;
+	std::vector<size_t> building; // GL thread only, entries between beginBuild and endBuild
+	std::mutex pendingMutex;
+	std::atomic<bool> hasPending{ false };
+	std::atomic<bool> running{ false };
+	std::thread worker;
+
+	static const int POLL_MS = 100;
+	static const int SETTLE_MS = 50; // editors save in several steps, let them finish
+
+	// worker: run the loader and remember the files it read, an include added by an edit is watched from then on
+	bool load(Entry& entry, ShaderSources& sources)
+	{
+		std::vector<std::string> files;
+		const bool loaded = entry.load(sources, files);
+		if (!loaded && !entry.files.empty())
+			return false; // keep the old list, a half written file may have lost its includes
+		entry.files.clear();
+		for (const std::string& file : files)
+			entry.files.push_back(normalize(file));
+		return loaded;
+	}
+	// worker: reload every entry using a changed file and queue the sources for the GL thread
+	void reload(const std::vector<std::filesystem::path>& changed)
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			Entry& entry = entries[i];
+			if (!usesAny(entry, changed))
+				continue;
+			Pending reload;
+			reload.entry = i;
+			if (!load(entry, reload.sources))
+				continue; // file vanished mid-save or has errors, the next event brings it back
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pending.push_back(reload);
+			hasPending.store(true, std::memory_order_release);
+		}
+	}
+	static bool usesAny(const Entry& entry, const std::vector<std::filesystem::path>& changed)
+	{
+		for (const std::filesystem::path& path : entry.files)
+		{
+			for (const std::filesystem::path& file : changed)
+			{
+				if (file == path)
+					return true;
+			}
+		}
+		return false;
+	}
+	static std::filesystem::path normalize(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+		return (error ? path : absolute).lexically_normal();
+	}
+
+#ifdef __linux__
+	// ------------------------------------------------------------------------
+	void run()
+	{
+		const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0)
+		{
+			std::cout << "ERROR::SHADER_WATCHER::INOTIFY_UNAVAILABLE" << std::endl;
+			return;
+		}
+		ShaderSources sources;
+		for (Entry& entry : entries)
+			load(entry, sources);
+		std::vector<std::pair<int, std::filesystem::path>> directories;
+		watchDirectories(fd, directories);
+
+		alignas(inotify_event) char buffer[4096];
+		std::vector<std::filesystem::path> changed;
+		while (running.load(std::memory_order_relaxed))
+		{
+			pollfd descriptor = { fd, POLLIN, 0 };
+			if (poll(&descriptor, 1, POLL_MS) <= 0)
+				continue;
+			std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+
+			changed.clear();
+			ssize_t length;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* cursor = buffer; cursor < buffer + length;)
+				{
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+					for (const auto& watched : directories)
+					{
+						if (watched.first == event->wd && event->len > 0)
+							changed.push_back((watched.second / event->name).lexically_normal());
+					}
+					cursor += sizeof(inotify_event) + event->len;
+				}
+			}
+			if (changed.empty())
+				continue;
+			reload(changed);
+			watchDirectories(fd, directories);
+		}
+		close(fd);
+	}
+	// watch directories, editors replace files by renaming over them
+	void watchDirectories(int fd, std::vector<std::pair<int, std::filesystem::path>>& directories)
+	{
+		for (const Entry& entry : entries)
+		{
+			for (const std::filesystem::path& file : entry.files)
+			{
+				const std::filesystem::path directory = file.parent_path();
+				bool known = false;
+				for (const auto& watched : directories)
+					known = known || watched.second == directory;
+				if (known)
+					continue;
+				const int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (wd >= 0)
+					directories.push_back(std::make_pair(wd, directory));
+			}
+		}
+	}
+#else
+	// ------------------------------------------------------------------------
+	void run()
+	{
+		ShaderSources sources;
+		for (Entry& entry : entries)
+			load(entry, sources);
+		std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> files;
+		watchFiles(files);
+
+		std::vector<std::filesystem::path> changed;
+		while (running.load(std::memory_order_relaxed))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+			changed.clear();
+			for (auto& file : files)
+			{
+				const std::filesystem::file_time_type time = lastWrite(file.first);
+				if (time != file.second)
+				{
+					file.second = time;
+					changed.push_back(file.first);
+				}
+			}
+			if (changed.empty())
+				continue;
+			std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+			reload(changed);
+			watchFiles(files);
+		}
+	}
+	void watchFiles(std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>>& files)
+	{
+		for (const Entry& entry : entries)
+		{
+			for (const std::filesystem::path& file : entry.files)
+			{
+				bool known = false;
+				for (const auto& watched : files)
+					known = known || watched.first == file;
+				if (!known)
+					files.push_back(std::make_pair(file, lastWrite(file)));
+			}
+		}
+	}
+	static std::filesystem::file_time_type lastWrite(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		return std::filesystem::last_write_time(path, error);
+	}
+#endif
+};
+#endif
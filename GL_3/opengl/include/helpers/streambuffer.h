@@ -0,0 +1,140 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <helpers/uploadcounter.h>
+
+#include <cstring>
+#include <iostream>
+
+// Ring buffer for data the CPU writes every frame (debug lines, particles, UI).
+// The storage is mapped once, persistently and coherently, and split into REGIONS regions.
+// Frame N writes region N % REGIONS straight through the pointer and fences it at endFrame().
+// beginFrame() only waits when the GPU is still reading the region from REGIONS frames ago,
+// so writing is a plain memcpy with no driver call and no implicit synchronization.
+class StreamBuffer
+{
+public:
+	static const unsigned int REGIONS = 3;
+	unsigned int ID = 0;
+
+	// ------------------------------------------------------------------------
+	bool create(size_t bytesPerFrame)
+	{
+		if (!GLAD_GL_VERSION_4_4)
+		{
+			std::cout << "ERROR::STREAM_BUFFER::NEEDS_GL_4_4" << std::endl;
+			return false;
+		}
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		regionSize = (bytesPerFrame + 255) & ~static_cast<size_t>(255);
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGIONS, NULL, flags);
+		mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGIONS, flags));
+		if (mapped == NULL)
+		{
+			std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+			destroy();
+			return false;
+		}
+		region = 0;
+		head = 0;
+		return true;
+	}
+	// moves to the next region, waits only if the GPU still reads it
+	// ------------------------------------------------------------------------
+	void beginFrame()
+	{
+		region = (region + 1) % REGIONS;
+		head = 0;
+		GLsync& fence = fences[region];
+		if (fence == NULL)
+			return;
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			stallCount++;
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		glDeleteSync(fence);
+		fence = NULL;
+	}
+	// room for bytes in this frame's region, offset is from the start of the buffer (for draw calls
+	// and attribute offsets), nullptr when the region is full
+	// ------------------------------------------------------------------------
+	void* allocate(size_t bytes, size_t alignment, size_t& offset)
+	{
+		const size_t start = region * regionSize;
+		size_t aligned = start + head;
+		if (alignment > 1)
+			aligned = (aligned + alignment - 1) / alignment * alignment;
+		if (aligned + bytes > start + regionSize)
+		{
+			std::cout << "ERROR::STREAM_BUFFER::REGION_FULL " << bytes << " bytes" << std::endl;
+			return nullptr;
+		}
+		head = aligned + bytes - start;
+		offset = aligned;
+		UploadCounter::record(bytes);
+		return mapped + aligned;
+	}
+	// count elements of T, aligned to T so offset / sizeof(T) is a valid first vertex
+	// ------------------------------------------------------------------------
+	template<typename T>
+	T* allocate(size_t count, size_t& offset)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), sizeof(T), offset));
+	}
+	// ------------------------------------------------------------------------
+	bool write(const void* data, size_t bytes, size_t alignment, size_t& offset)
+	{
+		void* target = allocate(bytes, alignment, offset);
+		if (target == nullptr)
+			return false;
+		memcpy(target, data, bytes);
+		return true;
+	}
+	// fences everything written this frame, call after the draws that read it
+	// ------------------------------------------------------------------------
+	void endFrame()
+	{
+		if (head > 0)
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		for (GLsync& fence : fences)
+		{
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+		if (mapped != NULL)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, ID);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			mapped = NULL;
+		}
+		glDeleteBuffers(1, &ID);
+		ID = 0;
+	}
+	// beginFrame() calls that had to wait for the GPU, should stay 0
+	// ------------------------------------------------------------------------
+	unsigned long long stalls() const
+	{
+		return stallCount;
+	}
+	size_t capacity() const
+	{
+		return regionSize;
+	}
+
+private:
+	unsigned char* mapped = NULL;
+	size_t regionSize = 0;
+	unsigned int region = 0;
+	size_t head = 0; // bytes used in the current region
+	GLsync fences[REGIONS] = {};
+	unsigned long long stallCount = 0;
+};
+#endif
@@ -0,0 +1,172 @@
+#ifndef TRANSFORMBATCH_H
+#define TRANSFORMBATCH_H
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+#include <glm/glm/simd/matrix.h> // glm_mat4_mul, GLM_ARCH
+
+#include <cstdint>
+#include <vector>
+
+// Translation/rotation/scale of many objects, stored as structure of arrays.
+// compute() turns a range into model matrices (t * r * s, as setTransform() does for one object)
+// and optionally model-view-projection matrices. With SSE2 it composes 4 objects per step, lane
+// by lane, transposes them into matrices and writes them with streaming stores, so the output can
+// be mapped GPU memory (StreamBuffer) without being read back through the cache.
+// Ranges are independent, separate threads can compute separate ranges.
+class TransformBatch
+{
+public:
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW; // unit quaternions
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// ------------------------------------------------------------------------
+	size_t add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		positionX.push_back(position.x);
+		positionY.push_back(position.y);
+		positionZ.push_back(position.z);
+		rotationX.push_back(rotation.x);
+		rotationY.push_back(rotation.y);
+		rotationZ.push_back(rotation.z);
+		rotationW.push_back(rotation.w);
+		scaleX.push_back(scale.x);
+		scaleY.push_back(scale.y);
+		scaleZ.push_back(scale.z);
+		return positionX.size() - 1;
+	}
+	// ------------------------------------------------------------------------
+	size_t size() const
+	{
+		return positionX.size();
+	}
+	// rotation = rotation * delta for objects first to end, a spin around each object's own axes
+	// ------------------------------------------------------------------------
+	void rotate(size_t first, size_t end, const glm::quat& delta)
+	{
+		size_t i = first;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		const __m128 dx = _mm_set1_ps(delta.x), dy = _mm_set1_ps(delta.y), dz = _mm_set1_ps(delta.z), dw = _mm_set1_ps(delta.w);
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(&rotationX[i]), y = _mm_loadu_ps(&rotationY[i]);
+			const __m128 z = _mm_loadu_ps(&rotationZ[i]), w = _mm_loadu_ps(&rotationW[i]);
+			__m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(w, dw), _mm_mul_ps(x, dx)), _mm_add_ps(_mm_mul_ps(y, dy), _mm_mul_ps(z, dz)));
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, dx), _mm_mul_ps(x, dw)), _mm_sub_ps(_mm_mul_ps(y, dz), _mm_mul_ps(z, dy)));
+			__m128 ry = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(w, dy), _mm_mul_ps(x, dz)), _mm_add_ps(_mm_mul_ps(y, dw), _mm_mul_ps(z, dx)));
+			__m128 rz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(w, dz), _mm_mul_ps(x, dy)), _mm_mul_ps(y, dx)), _mm_mul_ps(z, dw));
+			// renormalize, or rounding slowly scales the objects after many frames
+			const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw))));
+			_mm_storeu_ps(&rotationX[i], _mm_div_ps(rx, length));
+			_mm_storeu_ps(&rotationY[i], _mm_div_ps(ry, length));
+			_mm_storeu_ps(&rotationZ[i], _mm_div_ps(rz, length));
+			_mm_storeu_ps(&rotationW[i], _mm_div_ps(rw, length));
+		}
+#endif
+		for (; i < end; i++)
+		{
+			const glm::quat rotation = glm::normalize(glm::quat(rotationW[i], rotationX[i], rotationY[i], rotationZ[i]) * delta);
+			rotationX[i] = rotation.x;
+			rotationY[i] = rotation.y;
+			rotationZ[i] = rotation.z;
+			rotationW[i] = rotation.w;
+		}
+	}
+	// models[0] becomes the model matrix of object first
+	// ------------------------------------------------------------------------
+	void compute(size_t first, size_t end, glm::mat4* models) const
+	{
+		compute(first, end, glm::mat4(1.0f), models, nullptr);
+	}
+	// same, plus mvps[k] = viewProjection * models[k] when mvps is set
+	// ------------------------------------------------------------------------
+	void compute(size_t first, size_t end, const glm::mat4& viewProjection, glm::mat4* models, glm::mat4* mvps) const
+	{
+		size_t i = first;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		glm_vec4 projection[4];
+		for (int column = 0; column < 4; column++)
+			projection[column] = _mm_loadu_ps(&viewProjection[column][0]);
+		const bool aligned = reinterpret_cast<uintptr_t>(models) % 16 == 0 && (mvps == nullptr || reinterpret_cast<uintptr_t>(mvps) % 16 == 0);
+		const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(&rotationX[i]), y = _mm_loadu_ps(&rotationY[i]);
+			const __m128 z = _mm_loadu_ps(&rotationZ[i]), w = _mm_loadu_ps(&rotationW[i]);
+			const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+			const __m128 sx = _mm_loadu_ps(&scaleX[i]), sy = _mm_loadu_ps(&scaleY[i]), sz = _mm_loadu_ps(&scaleZ[i]);
+
+			// columns of r * s, one component per register, one object per lane (same terms as glm::mat3_cast)
+			__m128 c[4][4];
+			c[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+			c[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+			c[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+			c[0][3] = _mm_setzero_ps();
+			c[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+			c[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+			c[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+			c[1][3] = _mm_setzero_ps();
+			c[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+			c[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+			c[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+			c[2][3] = _mm_setzero_ps();
+			c[3][0] = _mm_loadu_ps(&positionX[i]);
+			c[3][1] = _mm_loadu_ps(&positionY[i]);
+			c[3][2] = _mm_loadu_ps(&positionZ[i]);
+			c[3][3] = one;
+
+			// after the transposes c[column][k] is that column of object i + k
+			for (int column = 0; column < 4; column++)
+				_MM_TRANSPOSE4_PS(c[column][0], c[column][1], c[column][2], c[column][3]);
+			for (int k = 0; k < 4; k++)
+			{
+				glm_vec4 model[4] = { c[0][k], c[1][k], c[2][k], c[3][k] };
+				store(&models[i - first + k], model, aligned);
+				if (mvps == nullptr)
+					continue;
+				glm_vec4 mvp[4];
+				glm_mat4_mul(projection, model, mvp);
+				store(&mvps[i - first + k], mvp, aligned);
+			}
+		}
+		if (aligned)
+			_mm_sfence(); // streaming stores are visible to other threads (and the GPU) after this
+#endif
+		for (; i < end; i++)
+		{
+			const glm::mat4 model = computeOne(i);
+			models[i - first] = model;
+			if (mvps != nullptr)
+				mvps[i - first] = viewProjection * model;
+		}
+	}
+	// ------------------------------------------------------------------------
+	glm::mat4 computeOne(size_t i) const
+	{
+		glm::mat4 model = glm::mat4_cast(glm::quat(rotationW[i], rotationX[i], rotationY[i], rotationZ[i]));
+		model[0] *= scaleX[i];
+		model[1] *= scaleY[i];
+		model[2] *= scaleZ[i];
+		model[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+		return model;
+	}
+
+private:
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	static void store(glm::mat4* target, const glm_vec4 matrix[4], bool aligned)
+	{
+		float* out = &(*target)[0][0];
+		for (int column = 0; column < 4; column++)
+		{
+			if (aligned)
+				_mm_stream_ps(out + column * 4, matrix[column]);
+			else
+				_mm_storeu_ps(out + column * 4, matrix[column]);
+		}
+	}
+#endif
+};
+#endif
@@ -0,0 +1,76 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+#include <helpers/uploadcounter.h>
+
+#include <cstring>
+
+// Binding points of the uniform blocks shared by every program.
+// Shader binds blocks with these names right after linking.
+namespace UniformBlocks
+{
+	enum Binding : unsigned int
+	{
+		CAMERA = 0,
+	};
+
+	struct Entry
+	{
+		const char* name;
+		Binding binding;
+	};
+	static const Entry entries[] = {
+		{ "Camera", CAMERA },
+	};
+}
+
+// std140 mirror of "layout (std140) uniform Camera" in the shaders, uploaded in frames where the camera changed
+struct CameraBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+};
+
+// Uniform buffer holding one T, bound to a fixed binding point for the lifetime of the program.
+// T has to follow std140 rules (vec4/mat4 members keep that trivially).
+template<typename T>
+class UniformBuffer
+{
+public:
+	unsigned int ID = 0;
+
+	// ------------------------------------------------------------------------
+	void create(unsigned int binding)
+	{
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		UploadCounter::bufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+	}
+	// skips the upload when nothing changed since the last frame
+	// ------------------------------------------------------------------------
+	void update(const T& data)
+	{
+		if (uploaded && memcmp(&data, &last, sizeof(T)) == 0)
+			return;
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		UploadCounter::bufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+		last = data;
+		uploaded = true;
+	}
+	// ------------------------------------------------------------------------
+	void destroy()
+	{
+		glDeleteBuffers(1, &ID);
+		ID = 0;
+		uploaded = false;
+	}
+
+private:
+	T last;
+	bool uploaded = false;
+};
+#endif
@@ -0,0 +1,89 @@
+#ifndef UPLOADCOUNTER_H
+#define UPLOADCOUNTER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <algorithm>
+
+// Bytes sent from the CPU into GPU buffers. The helpers upload through the wrappers below
+// (or record() writes into mapped memory), so a wrong size shows up as a wrong number here
+// instead of as silently wasted bandwidth. endFrame() closes the per-frame count.
+class UploadCounter
+{
+public:
+	// ------------------------------------------------------------------------
+	static void bufferData(GLenum target, size_t bytes, const void* data, GLenum usage)
+	{
+		if (data != NULL)
+			record(bytes);
+		glBufferData(target, bytes, data, usage);
+	}
+	// ------------------------------------------------------------------------
+	static void bufferStorage(GLenum target, size_t bytes, const void* data, GLbitfield flags)
+	{
+		if (data != NULL)
+			record(bytes);
+		glBufferStorage(target, bytes, data, flags);
+	}
+	// ------------------------------------------------------------------------
+	static void bufferSubData(GLenum target, size_t offset, size_t bytes, const void* data)
+	{
+		record(bytes);
+		glBufferSubData(target, offset, bytes, data);
+	}
+	// ------------------------------------------------------------------------
+	static void record(size_t bytes)
+	{
+		counters().frame += bytes;
+	}
+	// everything uploaded so far belongs to loading, not to the first frame
+	// ------------------------------------------------------------------------
+	static unsigned long long endSetup()
+	{
+		Counters& c = counters();
+		c.setup += c.frame;
+		c.total += c.frame;
+		c.frame = 0;
+		return c.setup;
+	}
+	// ------------------------------------------------------------------------
+	static void endFrame()
+	{
+		Counters& c = counters();
+		c.last = c.frame;
+		c.max = std::max(c.max, c.frame);
+		c.total += c.frame;
+		c.frames++;
+		c.frame = 0;
+	}
+	// ------------------------------------------------------------------------
+	static unsigned long long frameBytes() { return counters().frame; }
+	static unsigned long long lastFrameBytes() { return counters().last; }
+	static unsigned long long maxFrameBytes() { return counters().max; }
+	static unsigned long long totalBytes() { return counters().total + counters().frame; }
+	// ------------------------------------------------------------------------
+	static void print()
+	{
+		const Counters& c = counters();
+		std::cout << "Uploads: " << totalBytes() << " bytes total, " << c.setup << " setup, " << c.last << " last frame, " << c.max
+			<< " max frame, " << (c.frames > 0 ? (c.total - c.setup) / c.frames : 0) << " avg per frame" << std::endl;
+	}
+
+private:
+	struct Counters
+	{
+		unsigned long long setup = 0;
+		unsigned long long frame = 0; // since the last endFrame()
+		unsigned long long last = 0;
+		unsigned long long max = 0;
+		unsigned long long total = 0;
+		unsigned long long frames = 0;
+	};
+	static Counters& counters()
+	{
+		static Counters instance;
+		return instance;
+	}
+};
+#endif
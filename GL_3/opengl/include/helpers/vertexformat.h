@@ -0,0 +1,271 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm/glm.hpp>
+// glm's packing.inl memcpys into its vector types, which GCC flags with -Wclass-memaccess
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wclass-memaccess"
+#endif
+#include <glm/glm/gtc/packing.hpp>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// How one vertex attribute is stored, and the encoders that write it:
+// - positions as floats, half floats or normalized int16 (only inside [-1, 1]), the last two with
+//   a w of 1 so every vertex stays 4-byte aligned
+// - normals as floats or octahedral (Meyer et al., "On Floating-Point Normal Vectors"), two
+//   normalized int16 or int8, the vertex shader unfolds them with the inverse of octEncode()
+// - UVs as floats or normalized uint16 or uint8 (only inside [0, 1])
+// Every encoder has a decoder that reads the bytes back the way GL does, to measure the error.
+class VertexFormat
+{
+public:
+	enum Position { POSITION_FLOAT, POSITION_HALF, POSITION_SNORM16 };
+	enum Normal { NORMAL_FLOAT, NORMAL_OCT16, NORMAL_OCT8 };
+	enum TexCoord { UV_FLOAT, UV_UNORM16, UV_UNORM8 };
+
+	// ------------------------------------------------------------------------
+	static const char* name(Position format)
+	{
+		return format == POSITION_FLOAT ? "float" : format == POSITION_HALF ? "half" : "snorm16";
+	}
+	static const char* name(Normal format)
+	{
+		return format == NORMAL_FLOAT ? "float" : format == NORMAL_OCT16 ? "oct16" : "oct8";
+	}
+	static const char* name(TexCoord format)
+	{
+		return format == UV_FLOAT ? "float" : format == UV_UNORM16 ? "unorm16" : "unorm8";
+	}
+	// bytes per vertex
+	// ------------------------------------------------------------------------
+	static unsigned int size(Position format)
+	{
+		return format == POSITION_FLOAT ? 12 : 8;
+	}
+	static unsigned int size(Normal format)
+	{
+		return format == NORMAL_FLOAT ? 12 : format == NORMAL_OCT16 ? 4 : 2;
+	}
+	static unsigned int size(TexCoord format)
+	{
+		return format == UV_FLOAT ? 8 : format == UV_UNORM16 ? 4 : 2;
+	}
+	// ------------------------------------------------------------------------
+	static void encode(unsigned char* out, const glm::vec3& position, Position format)
+	{
+		if (format == POSITION_FLOAT)
+		{
+			memcpy(out, &position, sizeof(glm::vec3));
+			return;
+		}
+		const uint16_t packed[4] = {
+			pack(position.x, format), pack(position.y, format), pack(position.z, format), pack(1.0f, format)
+		};
+		memcpy(out, packed, sizeof(packed));
+	}
+	static glm::vec3 decode(const unsigned char* in, Position format)
+	{
+		glm::vec3 position;
+		if (format == POSITION_FLOAT)
+		{
+			memcpy(&position, in, sizeof(glm::vec3));
+			return position;
+		}
+		uint16_t packed[3];
+		memcpy(packed, in, sizeof(packed));
+		for (int i = 0; i < 3; i++)
+			position[i] = format == POSITION_HALF ? glm::unpackHalf1x16(packed[i]) : glm::unpackSnorm1x16(packed[i]);
+		return position;
+	}
+	// normal must be unit length
+	// ------------------------------------------------------------------------
+	static void encode(unsigned char* out, const glm::vec3& normal, Normal format)
+	{
+		if (format == NORMAL_FLOAT)
+		{
+			memcpy(out, &normal, sizeof(glm::vec3));
+			return;
+		}
+		const glm::vec2 folded = octEncode(normal);
+		if (format == NORMAL_OCT16)
+		{
+			const uint16_t packed[2] = { glm::packSnorm1x16(folded.x), glm::packSnorm1x16(folded.y) };
+			memcpy(out, packed, sizeof(packed));
+			return;
+		}
+		out[0] = glm::packSnorm1x8(folded.x);
+		out[1] = glm::packSnorm1x8(folded.y);
+	}
+	static glm::vec3 decode(const unsigned char* in, Normal format)
+	{
+		if (format == NORMAL_FLOAT)
+		{
+			glm::vec3 normal;
+			memcpy(&normal, in, sizeof(glm::vec3));
+			return normal;
+		}
+		if (format == NORMAL_OCT16)
+		{
+			uint16_t packed[2];
+			memcpy(packed, in, sizeof(packed));
+			return octDecode(glm::vec2(glm::unpackSnorm1x16(packed[0]), glm::unpackSnorm1x16(packed[1])));
+		}
+		return octDecode(glm::vec2(glm::unpackSnorm1x8(in[0]), glm::unpackSnorm1x8(in[1])));
+	}
+	// ------------------------------------------------------------------------
+	static void encode(unsigned char* out, const glm::vec2& uv, TexCoord format)
+	{
+		if (format == UV_FLOAT)
+		{
+			memcpy(out, &uv, sizeof(glm::vec2));
+			return;
+		}
+		if (format == UV_UNORM16)
+		{
+			const uint16_t packed[2] = { glm::packUnorm1x16(uv.x), glm::packUnorm1x16(uv.y) };
+			memcpy(out, packed, sizeof(packed));
+			return;
+		}
+		out[0] = glm::packUnorm1x8(uv.x);
+		out[1] = glm::packUnorm1x8(uv.y);
+	}
+	static glm::vec2 decode(const unsigned char* in, TexCoord format)
+	{
+		if (format == UV_FLOAT)
+		{
+			glm::vec2 uv;
+			memcpy(&uv, in, sizeof(glm::vec2));
+			return uv;
+		}
+		if (format == UV_UNORM16)
+		{
+			uint16_t packed[2];
+			memcpy(packed, in, sizeof(packed));
+			return glm::vec2(glm::unpackUnorm1x16(packed[0]), glm::unpackUnorm1x16(packed[1]));
+		}
+		return glm::vec2(glm::unpackUnorm1x8(in[0]), glm::unpackUnorm1x8(in[1]));
+	}
+	// the unit sphere projected onto the octahedron |x| + |y| + |z| = 1, its lower half folded
+	// over the upper one, so the square [-1, 1]^2 covers every direction
+	// ------------------------------------------------------------------------
+	static glm::vec2 octEncode(const glm::vec3& normal)
+	{
+		const glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+		if (n.z >= 0.0f)
+			return glm::vec2(n.x, n.y);
+		return glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	static glm::vec3 octDecode(const glm::vec2& folded)
+	{
+		glm::vec3 n(folded.x, folded.y, 1.0f - std::abs(folded.x) - std::abs(folded.y));
+		if (n.z < 0.0f)
+		{
+			n.x = (1.0f - std::abs(folded.y)) * (folded.x >= 0.0f ? 1.0f : -1.0f);
+			n.y = (1.0f - std::abs(folded.x)) * (folded.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return glm::normalize(n);
+	}
+
+private:
+	static uint16_t pack(float value, Position format)
+	{
+		return format == POSITION_HALF ? glm::packHalf1x16(value) : glm::packSnorm1x16(value);
+	}
+};
+
+// The attributes of one interleaved vertex, declared once: offsets follow from the order they
+// are added in (each aligned to its own component size) and the stride from all of them, rounded
+// up to 4 bytes. apply() points the bound vertex array at the bound GL_ARRAY_BUFFER with it, so
+// every vertex array reading the format is set up from the same declaration.
+class VertexLayout
+{
+public:
+	struct Attribute
+	{
+		GLuint location = 0;
+		GLint components = 0;
+		GLenum type = GL_FLOAT;
+		GLboolean normalized = GL_FALSE;
+		unsigned int offset = 0; // bytes into the vertex
+	};
+	std::vector<Attribute> attributes;
+
+	// ------------------------------------------------------------------------
+	VertexLayout& add(GLuint location, VertexFormat::Position format)
+	{
+		if (format == VertexFormat::POSITION_FLOAT)
+			return add(location, 3, GL_FLOAT, GL_FALSE);
+		return add(location, 4, format == VertexFormat::POSITION_HALF ? GL_HALF_FLOAT : GL_SHORT, format == VertexFormat::POSITION_SNORM16);
+	}
+	VertexLayout& add(GLuint location, VertexFormat::Normal format)
+	{
+		if (format == VertexFormat::NORMAL_FLOAT)
+			return add(location, 3, GL_FLOAT, GL_FALSE);
+		return add(location, 2, format == VertexFormat::NORMAL_OCT16 ? GL_SHORT : GL_BYTE, GL_TRUE);
+	}
+	VertexLayout& add(GLuint location, VertexFormat::TexCoord format)
+	{
+		if (format == VertexFormat::UV_FLOAT)
+			return add(location, 2, GL_FLOAT, GL_FALSE);
+		return add(location, 2, format == VertexFormat::UV_UNORM16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, GL_TRUE);
+	}
+	// ------------------------------------------------------------------------
+	unsigned int stride() const
+	{
+		unsigned int end = 0;
+		for (const Attribute& attribute : attributes)
+			end = std::max(end, attribute.offset + attribute.components * typeSize(attribute.type));
+		return (end + 3) / 4 * 4;
+	}
+	// where the attribute at location starts inside a vertex, for the encoders
+	unsigned int offset(GLuint location) const
+	{
+		for (const Attribute& attribute : attributes)
+		{
+			if (attribute.location == location)
+				return attribute.offset;
+		}
+		return 0;
+	}
+	// ------------------------------------------------------------------------
+	void apply() const
+	{
+		const GLsizei bytes = static_cast<GLsizei>(stride());
+		for (const Attribute& attribute : attributes)
+		{
+			glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, bytes, (void*)(size_t)attribute.offset);
+			glEnableVertexAttribArray(attribute.location);
+		}
+	}
+	// ------------------------------------------------------------------------
+	static unsigned int typeSize(GLenum type)
+	{
+		return type == GL_FLOAT ? 4 : type == GL_HALF_FLOAT || type == GL_SHORT || type == GL_UNSIGNED_SHORT ? 2 : 1;
+	}
+
+private:
+	VertexLayout& add(GLuint location, GLint components, GLenum type, GLboolean normalized)
+	{
+		Attribute attribute;
+		attribute.location = location;
+		attribute.components = components;
+		attribute.type = type;
+		attribute.normalized = normalized;
+		//Right after the last attribute, not at the rounded stride
+		const unsigned int end = attributes.empty() ? 0 : attributes.back().offset + attributes.back().components * typeSize(attributes.back().type);
+		attribute.offset = (end + typeSize(type) - 1) / typeSize(type) * typeSize(type);
+		attributes.push_back(attribute);
+		return *this;
+	}
+};
+#endif